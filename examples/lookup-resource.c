@@ -49,6 +49,7 @@ main (int   argc,
   gchar *username = NULL;
   gchar *password = NULL;
   gchar *domain = NULL;
+  gchar *cache = NULL;
 
   GOptionEntry entries[] =
     {
@@ -62,6 +63,8 @@ main (int   argc,
         N_("The username to use for authenication"), N_("USERNAME") },
       { "password", 'p', 0, G_OPTION_ARG_STRING, &password,
         N_("The password to use for authenication"), N_("PASSWORD") },
+      { "endpoint-cache", 'c', 0, G_OPTION_ARG_FILENAME, &cache,
+        N_("File for remembering the publisher's address"), N_("FILENAME") },
       { NULL, 0, 0, 0, NULL, NULL, NULL }
     };
 
@@ -92,6 +95,11 @@ main (int   argc,
   if (password)
     epc_consumer_set_password (consumer, password);
 
+  /* Skip service discovery, when the publisher's address is known. */
+
+  if (cache)
+    epc_consumer_set_endpoint_cache (consumer, cache);
+
   /* Query the resources specified on command line. */
 
   if (argc > 1)
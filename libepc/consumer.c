@@ -28,10 +28,12 @@
 #include "libepc/enums.h"
 #include "libepc/marshal.h"
 #include "libepc/service-monitor.h"
+#include "libepc/service-type.h"
 #include "libepc/shell.h"
 
 #include <glib/gi18n-lib.h>
 #include <libsoup/soup.h>
+#include <errno.h>
 #include <string.h>
 
 /**
@@ -101,7 +103,11 @@
  */
 
 #define EPC_CONSUMER_DEFAULT_TIMEOUT 5000
+#define EPC_DISCOVERY_LINGER_TIMEOUT 30
+#define EPC_LISTING_MIME_TYPE        "application/x-epc-list"
 
+typedef struct _EpcAsyncRequest EpcAsyncRequest;
+typedef struct _EpcDiscovery    EpcDiscovery;
 typedef struct _EpcListingState EpcListingState;
 
 typedef enum
@@ -124,7 +130,8 @@ enum
   PROP_PORT,
   PROP_PATH,
   PROP_USERNAME,
-  PROP_PASSWORD
+  PROP_PASSWORD,
+  PROP_ENDPOINT_CACHE
 };
 
 enum
@@ -143,10 +150,21 @@ struct _EpcConsumerPrivate
 {
   /* supportive objects */
 
+  EpcDiscovery      *discovery;
   EpcServiceMonitor *service_monitor;
   SoupSession       *session;
   GMainLoop         *loop;
 
+  /* resolved services delivered already, guarded by services_lock */
+
+  GHashTable        *known_services;
+  GMutex             services_lock;
+
+  /* asynchronous requests waiting for the publisher */
+
+  GList             *pending_tasks;
+  GSource           *pending_timeout;
+
   /* search parameters */
 
   gchar       *application;
@@ -164,6 +182,39 @@ struct _EpcConsumerPrivate
   gchar       *hostname;
   gchar       *path;
   guint16      port;
+
+  /* endpoint cache */
+
+  gchar       *endpoint_cache;
+  gchar       *fingerprint;
+  gboolean     optimistic;
+};
+
+struct _EpcAsyncRequest
+{
+  gchar       *argument;
+  SoupMessage *message;
+  gulong       cancelled_id;
+  gboolean     optimistic;
+
+  /* Listings received so far, when the publisher sends them in pages. */
+  GList       *items;
+  gchar       *continuation;
+};
+
+/* Service discovery shared by all consumers searching the same service
+ * types, so that short-lived consumers neither create new Avahi browsers,
+ * nor wait for resolving publishers already known to the monitor's
+ * directory. The discovery lingers for EPC_DISCOVERY_LINGER_TIMEOUT
+ * seconds after its last consumer is gone.
+ */
+struct _EpcDiscovery
+{
+  gint               ref_count;
+  gchar             *key;
+  EpcServiceMonitor *monitor;
+  GHashTable        *names;
+  guint              linger_id;
 };
 
 struct _EpcListingState
@@ -171,12 +222,37 @@ struct _EpcListingState
   EpcListingElementType element;
   GString              *name;
   GList                *items;
+  gchar                *continuation;
+};
+
+/**
+ * EpcListCursor:
+ *
+ * Opaque structure for iterating the keys published by an #EpcPublisher
+ * page by page. See epc_consumer_list_cursor_new().
+ */
+struct _EpcListCursor
+{
+  EpcConsumer *consumer;
+  gchar       *pattern;
+  guint        page_size;
+
+  GList       *page;
+  gchar       *current;
+  gchar       *continuation;
+  gboolean     started;
 };
 
 static guint signals[SIGNAL_LAST];
 
 G_DEFINE_TYPE (EpcConsumer, epc_consumer, G_TYPE_OBJECT);
 
+static void epc_consumer_flush_tasks    (EpcConsumer *self);
+static void epc_consumer_load_endpoint  (EpcConsumer *self);
+static void epc_consumer_store_endpoint (EpcConsumer *self);
+static void epc_consumer_queue_task     (EpcConsumer *self,
+                                         GTask       *task);
+
 static void
 epc_consumer_authenticate_cb (SoupSession  *session G_GNUC_UNUSED,
                               SoupMessage  *message,
@@ -188,6 +264,12 @@ epc_consumer_authenticate_cb (SoupSession  *session G_GNUC_UNUSED,
   const char *username, *password;
   gboolean handled = FALSE;
 
+  /* Never answer challenges of a cached endpoint,
+   * unless its certificate has been checked. */
+  if (g_object_get_data (G_OBJECT (message), "epc-fingerprint") &&
+      !g_object_get_data (G_OBJECT (message), "epc-verified"))
+    return;
+
   if (EPC_DEBUG_LEVEL (1))
     g_debug ("%s: path=%s, realm=%s, retrying=%d",
              G_STRLOC, soup_message_get_uri (message)->path,
@@ -226,6 +308,13 @@ epc_consumer_init (EpcConsumer *self)
 {
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self, EPC_TYPE_CONSUMER, EpcConsumerPrivate);
   self->priv->loop = g_main_loop_new (NULL, FALSE);
+
+  self->priv->known_services = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                      (GDestroyNotify) epc_service_info_unref,
+                                                      NULL);
+  g_mutex_init (&self->priv->services_lock);
+
+  /* Plain sessions transparently decode compressed responses. */
   self->priv->session = soup_session_new ();
 
   g_signal_connect (self->priv->session, "authenticate",
@@ -288,6 +377,18 @@ epc_consumer_set_property (GObject      *object,
         self->priv->password = g_value_dup_string (value);
         break;
 
+      case PROP_ENDPOINT_CACHE:
+        g_free (self->priv->endpoint_cache);
+        self->priv->endpoint_cache = g_value_dup_string (value);
+
+        /* Service discovery might have found the publisher already. */
+        if (self->priv->discovery && self->priv->hostname)
+          epc_consumer_store_endpoint (self);
+        else
+          epc_consumer_load_endpoint (self);
+
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -340,12 +441,466 @@ epc_consumer_get_property (GObject    *object,
         g_value_set_string (value, self->priv->password);
         break;
 
+      case PROP_ENDPOINT_CACHE:
+        g_value_set_string (value, self->priv->endpoint_cache);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
     }
 }
 
+static GHashTable *epc_discovery_cache = NULL;
+static GMutex epc_discovery_lock;
+
+static void
+epc_discovery_free (EpcDiscovery *discovery)
+{
+  g_object_unref (discovery->monitor);
+  g_hash_table_unref (discovery->names);
+  g_free (discovery->key);
+
+  g_slice_free (EpcDiscovery, discovery);
+}
+
+static gboolean
+epc_discovery_linger_cb (gpointer data)
+{
+  EpcDiscovery *discovery = data;
+
+  g_mutex_lock (&epc_discovery_lock);
+
+  /* A new consumer might have acquired the discovery meanwhile. */
+  if (discovery->ref_count > 0)
+    {
+      g_mutex_unlock (&epc_discovery_lock);
+      return FALSE;
+    }
+
+  discovery->linger_id = 0;
+  g_hash_table_remove (epc_discovery_cache, discovery->key);
+
+  g_mutex_unlock (&epc_discovery_lock);
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: releasing discovery for `%s'", G_STRLOC, discovery->key);
+
+  epc_discovery_free (discovery);
+
+  return FALSE;
+}
+
+/* Only resolves the publishers the consumers are looking for. */
+static void
+epc_discovery_update_names (EpcDiscovery *discovery,
+                            const gchar  *name,
+                            gint          delta)
+{
+  GHashTableIter iter;
+  gchar **names;
+  gpointer key;
+  gint count, i = 0;
+
+  if (!name)
+    return;
+
+  count = GPOINTER_TO_INT (g_hash_table_lookup (discovery->names, name));
+  count += delta;
+
+  if (count > 0)
+    g_hash_table_replace (discovery->names, g_strdup (name), GINT_TO_POINTER (count));
+  else
+    g_hash_table_remove (discovery->names, name);
+
+  if (count > 1 || (count == 1 && delta < 0))
+    return;
+
+  names = g_new0 (gchar*, g_hash_table_size (discovery->names) + 1);
+  g_hash_table_iter_init (&iter, discovery->names);
+
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    names[i++] = key;
+
+  epc_service_monitor_set_name_filter (discovery->monitor, names);
+  g_free (names);
+}
+
+static EpcDiscovery*
+epc_discovery_acquire (const gchar *application,
+                       const gchar *domain,
+                       EpcProtocol  protocol,
+                       const gchar *name)
+{
+  gchar *names[] = { (gchar*) name, NULL };
+  gchar *types[] = { NULL, NULL };
+  EpcDiscovery *discovery;
+  gchar *key;
+
+  key = g_strdup_printf ("%s\n%s\n%d", application ? application : "",
+                         domain ? domain : "", protocol);
+
+  g_mutex_lock (&epc_discovery_lock);
+
+  if (G_UNLIKELY (!epc_discovery_cache))
+    epc_discovery_cache = g_hash_table_new (g_str_hash, g_str_equal);
+
+  discovery = g_hash_table_lookup (epc_discovery_cache, key);
+
+  if (discovery)
+    {
+      if (discovery->linger_id)
+        {
+          g_source_remove (discovery->linger_id);
+          discovery->linger_id = 0;
+        }
+
+      discovery->ref_count += 1;
+      epc_discovery_update_names (discovery, name, +1);
+      g_free (key);
+    }
+  else
+    {
+      discovery = g_slice_new0 (EpcDiscovery);
+      discovery->ref_count = 1;
+      discovery->key = key;
+
+      discovery->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+      if (name)
+        g_hash_table_insert (discovery->names, g_strdup (name), GINT_TO_POINTER (1));
+
+      if (((gint) protocol) > EPC_PROTOCOL_UNKNOWN)
+        types[0] = epc_service_type_new (protocol, application);
+
+      discovery->monitor = g_object_new (EPC_TYPE_SERVICE_MONITOR,
+                                         "application", application,
+                                         "service-types", types,
+                                         "domain", domain,
+                                         "name-filter", names,
+                                         NULL);
+
+      g_free (types[0]);
+
+      g_hash_table_insert (epc_discovery_cache, discovery->key, discovery);
+    }
+
+  g_mutex_unlock (&epc_discovery_lock);
+
+  return discovery;
+}
+
+static void
+epc_discovery_release (EpcDiscovery *discovery,
+                       const gchar  *name)
+{
+  g_mutex_lock (&epc_discovery_lock);
+
+  discovery->ref_count -= 1;
+  epc_discovery_update_names (discovery, name, -1);
+
+  if (0 == discovery->ref_count)
+    discovery->linger_id = g_timeout_add_seconds (EPC_DISCOVERY_LINGER_TIMEOUT,
+                                                  epc_discovery_linger_cb,
+                                                  discovery);
+
+  g_mutex_unlock (&epc_discovery_lock);
+}
+
+static GKeyFile*
+epc_consumer_read_endpoint_cache (EpcConsumer *self)
+{
+  GKeyFile *cache = g_key_file_new ();
+  GError *error = NULL;
+
+  if (!g_key_file_load_from_file (cache, self->priv->endpoint_cache,
+                                  G_KEY_FILE_KEEP_COMMENTS, &error))
+    {
+      if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_warning ("%s: Cannot read endpoint cache `%s': %s",
+                   G_STRFUNC, self->priv->endpoint_cache, error->message);
+
+      g_clear_error (&error);
+    }
+
+  return cache;
+}
+
+static void
+epc_consumer_write_endpoint_cache (EpcConsumer *self,
+                                   GKeyFile    *cache)
+{
+  GError *error = NULL;
+  gchar *dirname;
+  gchar *data;
+  gsize length;
+
+  data = g_key_file_to_data (cache, &length, NULL);
+  dirname = g_path_get_dirname (self->priv->endpoint_cache);
+
+  if (g_mkdir_with_parents (dirname, 0700) < 0 ||
+      !g_file_set_contents (self->priv->endpoint_cache, data, length, &error))
+    {
+      g_warning ("%s: Cannot write endpoint cache `%s': %s",
+                 G_STRFUNC, self->priv->endpoint_cache,
+                 error ? error->message : g_strerror (errno));
+
+      g_clear_error (&error);
+    }
+
+  g_free (dirname);
+  g_free (data);
+}
+
+static gboolean
+epc_consumer_update_cache_entry (GKeyFile    *cache,
+                                 const gchar *group,
+                                 const gchar *key,
+                                 const gchar *value)
+{
+  gchar *current = g_key_file_get_string (cache, group, key, NULL);
+  gboolean changed = (0 != g_strcmp0 (current, value));
+
+  if (changed && value)
+    g_key_file_set_string (cache, group, key, value);
+  else if (changed)
+    g_key_file_remove_key (cache, group, key, NULL);
+
+  g_free (current);
+
+  return changed;
+}
+
+/* Stores the publisher's current endpoint in the endpoint cache,
+ * unless the cache already holds exactly that information.
+ */
+static void
+epc_consumer_store_endpoint (EpcConsumer *self)
+{
+  const gchar *group = self->priv->name;
+  gboolean changed = FALSE;
+  GKeyFile *cache;
+  gchar port[8];
+  gchar *type;
+
+  if (!self->priv->endpoint_cache || !group || !self->priv->hostname)
+    return;
+
+  type = epc_service_type_new (self->priv->protocol, self->priv->application);
+
+  if (!type)
+    return;
+
+  g_snprintf (port, sizeof port, "%u", self->priv->port);
+  cache = epc_consumer_read_endpoint_cache (self);
+
+  changed |= epc_consumer_update_cache_entry (cache, group, "type", type);
+  changed |= epc_consumer_update_cache_entry (cache, group, "host", self->priv->hostname);
+  changed |= epc_consumer_update_cache_entry (cache, group, "port", port);
+  changed |= epc_consumer_update_cache_entry (cache, group, "path", self->priv->path);
+  changed |= epc_consumer_update_cache_entry (cache, group, "fingerprint", self->priv->fingerprint);
+
+  if (changed)
+    epc_consumer_write_endpoint_cache (self, cache);
+
+  g_key_file_free (cache);
+  g_free (type);
+}
+
+/* Uses the publisher's last known endpoint from the endpoint cache
+ * until service discovery resolves the publisher.
+ */
+static void
+epc_consumer_load_endpoint (EpcConsumer *self)
+{
+  const gchar *group = self->priv->name;
+  EpcProtocol protocol = EPC_PROTOCOL_UNKNOWN;
+  gchar *fingerprint, *expected = NULL;
+  gchar *type, *host, *path;
+  GKeyFile *cache;
+  gint port;
+
+  if (!self->priv->endpoint_cache || !group || self->priv->hostname)
+    return;
+
+  cache = epc_consumer_read_endpoint_cache (self);
+
+  type = g_key_file_get_string (cache, group, "type", NULL);
+  host = g_key_file_get_string (cache, group, "host", NULL);
+  port = g_key_file_get_integer (cache, group, "port", NULL);
+  path = g_key_file_get_string (cache, group, "path", NULL);
+  fingerprint = g_key_file_get_string (cache, group, "fingerprint", NULL);
+
+  if (type)
+    protocol = epc_service_type_get_protocol (type);
+  if (EPC_PROTOCOL_UNKNOWN != protocol)
+    expected = epc_service_type_new (protocol, self->priv->application);
+
+  /* Only use endpoints announced for this application, and
+   * never downgrade the transport protocol of the consumer. Plain
+   * HTTP endpoints are ignored, as they cannot be verified. */
+  if (host && path && port > 0 && port <= G_MAXUINT16 &&
+      expected && 0 == strcmp (type, expected) &&
+      EPC_PROTOCOL_HTTPS == protocol && fingerprint &&
+      protocol >= self->priv->protocol)
+    {
+      if (EPC_DEBUG_LEVEL (1))
+        g_debug ("%s: Using cached endpoint: type='%s', host='%s', port=%d, path='%s'",
+                 G_STRLOC, type, host, port, path);
+
+      g_free (self->priv->path);
+      g_free (self->priv->fingerprint);
+
+      self->priv->protocol = protocol;
+      self->priv->hostname = host;
+      self->priv->port = port;
+      self->priv->path = path;
+      self->priv->fingerprint = fingerprint;
+      self->priv->optimistic = TRUE;
+
+      host = path = fingerprint = NULL;
+    }
+
+  g_key_file_free (cache);
+  g_free (fingerprint);
+  g_free (expected);
+  g_free (type);
+  g_free (host);
+  g_free (path);
+}
+
+static gchar*
+epc_consumer_get_fingerprint (SoupMessage *message)
+{
+  GTlsCertificate *certificate = NULL;
+  gchar *fingerprint = NULL;
+  GByteArray *der = NULL;
+
+  if (!soup_message_get_https_status (message, &certificate, NULL) || !certificate)
+    return NULL;
+
+  g_object_get (certificate, "certificate", &der, NULL);
+
+  if (der)
+    {
+      fingerprint = g_compute_checksum_for_data (G_CHECKSUM_SHA256, der->data, der->len);
+      g_byte_array_unref (der);
+    }
+
+  return fingerprint;
+}
+
+/* Cancels requests to a cached endpoint before anything is sent,
+ * unless the endpoint presents the certificate seen before.
+ */
+static void
+epc_consumer_verify_endpoint_cb (SoupMessage *message,
+                                 gpointer     data)
+{
+  const gchar *expected = g_object_get_data (G_OBJECT (message), "epc-fingerprint");
+  EpcConsumer *self = EPC_CONSUMER (data);
+  gchar *fingerprint;
+
+  if (!expected)
+    return;
+
+  fingerprint = epc_consumer_get_fingerprint (message);
+
+  if (g_strcmp0 (fingerprint, expected))
+    {
+      if (EPC_DEBUG_LEVEL (1))
+        g_debug ("%s: Certificate mismatch: expected=%s, found=%s",
+                 G_STRLOC, expected, fingerprint);
+
+      soup_session_cancel_message (self->priv->session, message,
+                                   SOUP_STATUS_SSL_FAILED);
+    }
+  else
+    g_object_set_data (G_OBJECT (message), "epc-verified", GINT_TO_POINTER (TRUE));
+
+  g_free (fingerprint);
+}
+
+/* Prepares @request for being sent to the current endpoint. Requests for
+ * a cached endpoint check its certificate before sending anything.
+ */
+static void
+epc_consumer_guard_request (EpcConsumer *self,
+                            SoupMessage *request)
+{
+  g_signal_handlers_disconnect_by_func (request, epc_consumer_verify_endpoint_cb, self);
+  g_object_set_data (G_OBJECT (request), "epc-verified", NULL);
+
+  if (self->priv->optimistic && self->priv->fingerprint)
+    {
+      g_object_set_data_full (G_OBJECT (request), "epc-fingerprint",
+                              g_strdup (self->priv->fingerprint), g_free);
+      g_signal_connect (request, "starting",
+                        G_CALLBACK (epc_consumer_verify_endpoint_cb), self);
+    }
+  else
+    g_object_set_data (G_OBJECT (request), "epc-fingerprint", NULL);
+}
+
+/* Checks if @message failed because the cached endpoint it was sent to
+ * is gone, or meanwhile is used by some other publisher.
+ */
+static gboolean
+epc_consumer_endpoint_failed (SoupMessage *message)
+{
+  if (SOUP_STATUS_IS_TRANSPORT_ERROR (message->status_code))
+    return TRUE;
+
+  return g_object_get_data (G_OBJECT (message), "epc-fingerprint") &&
+         !g_object_get_data (G_OBJECT (message), "epc-verified");
+}
+
+/* Remembers the certificate of a publisher found by service discovery,
+ * so that later processes can verify its cached endpoint.
+ */
+static void
+epc_consumer_remember_certificate (EpcConsumer *self,
+                                   SoupMessage *message)
+{
+  SoupURI *uri = soup_message_get_uri (message);
+  gchar *fingerprint;
+
+  if (!self->priv->endpoint_cache || self->priv->optimistic ||
+      !SOUP_STATUS_IS_SUCCESSFUL (message->status_code) ||
+      g_strcmp0 (uri->host, self->priv->hostname) ||
+      uri->port != self->priv->port)
+    return;
+
+  fingerprint = epc_consumer_get_fingerprint (message);
+
+  if (fingerprint && g_strcmp0 (fingerprint, self->priv->fingerprint))
+    {
+      g_free (self->priv->fingerprint);
+      self->priv->fingerprint = fingerprint;
+      epc_consumer_store_endpoint (self);
+    }
+  else
+    g_free (fingerprint);
+}
+
+static gboolean
+epc_consumer_remember_service (EpcConsumer    *self,
+                               EpcServiceInfo *info)
+{
+  gboolean known;
+
+  g_mutex_lock (&self->priv->services_lock);
+
+  known = g_hash_table_contains (self->priv->known_services, info);
+
+  if (!known)
+    g_hash_table_add (self->priv->known_services, epc_service_info_ref (info));
+
+  g_mutex_unlock (&self->priv->services_lock);
+
+  return !known;
+}
+
 static void
 epc_consumer_service_found_cb (EpcConsumer    *self,
                                const gchar    *name,
@@ -365,8 +920,17 @@ epc_consumer_service_found_cb (EpcConsumer    *self,
   if (name && strcmp (name, self->priv->name))
     return;
 
+  /* Services resolved while the consumer was constructed are
+   * reported by the monitor's signal and its directory. */
+  if (!epc_consumer_remember_service (self, info))
+    return;
+
   g_assert (EPC_PROTOCOL_HTTPS > EPC_PROTOCOL_HTTP);
 
+  /* Service discovery overrules the protocol of cached endpoints. */
+  if (self->priv->optimistic)
+    self->priv->protocol = EPC_PROTOCOL_UNKNOWN;
+
   if (transport > self->priv->protocol)
     {
       if (EPC_DEBUG_LEVEL (1))
@@ -378,13 +942,61 @@ epc_consumer_service_found_cb (EpcConsumer    *self,
 
   g_main_loop_quit (self->priv->loop);
 
+  /* The certificate remembered for another endpoint is meaningless. */
+  if (g_strcmp0 (host, self->priv->hostname) || port != self->priv->port)
+    {
+      g_free (self->priv->fingerprint);
+      self->priv->fingerprint = NULL;
+    }
+
   g_free (self->priv->path);
   g_free (self->priv->hostname);
 
   /* Use /get path as fallback for libepc-0.2 publishers */
   self->priv->path = g_strdup (path ? path : "/get");
   self->priv->hostname = g_strdup (host);
+  self->priv->optimistic = FALSE;
   self->priv->port = port;
+
+  epc_consumer_store_endpoint (self);
+  epc_consumer_flush_tasks (self);
+}
+
+static void
+epc_consumer_service_known_cb (EpcServiceMonitor *monitor G_GNUC_UNUSED,
+                               const gchar       *name,
+                               EpcServiceInfo    *info,
+                               gpointer           data)
+{
+  epc_consumer_service_found_cb (data, name, info);
+}
+
+/* Drops the cached endpoint after it failed,
+ * to wait for service discovery instead.
+ */
+static void
+epc_consumer_forget_endpoint (EpcConsumer *self)
+{
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: Cached endpoint %s:%d failed, waiting for service discovery",
+             G_STRLOC, self->priv->hostname, self->priv->port);
+
+  g_free (self->priv->hostname);
+  g_free (self->priv->fingerprint);
+
+  self->priv->hostname = NULL;
+  self->priv->fingerprint = NULL;
+  self->priv->optimistic = FALSE;
+  self->priv->port = 0;
+
+  /* Known services are candidates again. */
+  g_mutex_lock (&self->priv->services_lock);
+  g_hash_table_remove_all (self->priv->known_services);
+  g_mutex_unlock (&self->priv->services_lock);
+
+  if (self->priv->service_monitor)
+    epc_service_monitor_foreach (self->priv->service_monitor, self->priv->name,
+                                 epc_consumer_service_known_cb, self);
 }
 
 static void
@@ -397,14 +1009,20 @@ epc_consumer_constructed (GObject *object)
 
   if (!self->priv->hostname)
     {
-      self->priv->service_monitor = epc_service_monitor_new (self->priv->application,
-                                                             self->priv->domain,
-                                                             self->priv->protocol,
-                                                             EPC_PROTOCOL_UNKNOWN);
+      self->priv->discovery = epc_discovery_acquire (self->priv->application,
+                                                     self->priv->domain,
+                                                     self->priv->protocol,
+                                                     self->priv->name);
+      self->priv->service_monitor = self->priv->discovery->monitor;
 
       g_signal_connect_swapped (self->priv->service_monitor, "service-found",
                                 G_CALLBACK (epc_consumer_service_found_cb),
                                 self);
+
+      /* Use publishers resolved for previous consumers right away. */
+      if (self->priv->name)
+        epc_service_monitor_foreach (self->priv->service_monitor, self->priv->name,
+                                     epc_consumer_service_known_cb, self);
     }
 }
 
@@ -413,10 +1031,15 @@ epc_consumer_dispose (GObject *object)
 {
   EpcConsumer *self = EPC_CONSUMER (object);
 
-  if (self->priv->service_monitor)
+  if (self->priv->discovery)
     {
-      g_object_unref (self->priv->service_monitor);
+      g_signal_handlers_disconnect_by_func (self->priv->service_monitor,
+                                            epc_consumer_service_found_cb,
+                                            self);
+
+      epc_discovery_release (self->priv->discovery, self->priv->name);
       self->priv->service_monitor = NULL;
+      self->priv->discovery = NULL;
     }
 
   if (self->priv->session)
@@ -452,9 +1075,26 @@ epc_consumer_dispose (GObject *object)
   g_free (self->priv->path);
   self->priv->path = NULL;
 
+  g_free (self->priv->endpoint_cache);
+  self->priv->endpoint_cache = NULL;
+
+  g_free (self->priv->fingerprint);
+  self->priv->fingerprint = NULL;
+
   G_OBJECT_CLASS (epc_consumer_parent_class)->dispose (object);
 }
 
+static void
+epc_consumer_finalize (GObject *object)
+{
+  EpcConsumer *self = EPC_CONSUMER (object);
+
+  g_hash_table_unref (self->priv->known_services);
+  g_mutex_clear (&self->priv->services_lock);
+
+  G_OBJECT_CLASS (epc_consumer_parent_class)->finalize (object);
+}
+
 static void
 epc_consumer_class_init (EpcConsumerClass *cls)
 {
@@ -464,6 +1104,7 @@ epc_consumer_class_init (EpcConsumerClass *cls)
   oclass->get_property = epc_consumer_get_property;
   oclass->constructed = epc_consumer_constructed;
   oclass->dispose = epc_consumer_dispose;
+  oclass->finalize = epc_consumer_finalize;
 
   g_object_class_install_property (oclass, PROP_NAME,
                                    g_param_spec_string ("name", "Name",
@@ -533,6 +1174,34 @@ epc_consumer_class_init (EpcConsumerClass *cls)
                                                         G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
                                                         G_PARAM_STATIC_BLURB));
 
+  /**
+   * EpcConsumer:endpoint-cache:
+   *
+   * File name of the cache remembering the last known endpoints of
+   * publishers, or %NULL to disable that cache.
+   *
+   * When a consumer created with epc_consumer_new_for_name() finds its
+   * publisher in that cache, it contacts the cached endpoint right away
+   * instead of waiting for DNS-SD to resolve the publisher. Service
+   * discovery still runs in parallel: When the cached endpoint cannot be
+   * reached, or presents a different certificate than before, the consumer
+   * falls back to the discovered endpoint. Publishers found by service
+   * discovery are stored in the cache.
+   *
+   * The certificate of a cached endpoint is checked before sending any
+   * request or credentials to it. Therefore only HTTPS publishers
+   * whose certificate is known are used from the cache.
+   *
+   * Since: 1.10
+   */
+  g_object_class_install_property (oclass, PROP_ENDPOINT_CACHE,
+                                   g_param_spec_string ("endpoint-cache", "Endpoint Cache",
+                                                        "File name of the cache for publisher endpoints",
+                                                        NULL,
+                                                        G_PARAM_READWRITE |
+                                                        G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
+                                                        G_PARAM_STATIC_BLURB));
+
   /**
    * EpcConsumer::authenticate:
    * @consumer: the #EpcConsumer emitting the signal
@@ -672,6 +1341,15 @@ epc_consumer_new_for_name (const gchar *name)
  *  described by @name.
  * </para></note>
  *
+ * Consumers searching the same @application and @domain share their service
+ * discovery. Publishers found for previous consumers are used right away,
+ * and the discovery is kept alive for a few seconds after the last consumer
+ * using it was released.
+ *
+ * To avoid waiting for service discovery when the program starts,
+ * publishers can be remembered between runs by setting an
+ * #EpcConsumer:endpoint-cache.
+ *
  * Returns: The newly created #EpcConsumer object
  */
 EpcConsumer*
@@ -735,6 +1413,26 @@ epc_consumer_set_password (EpcConsumer *self,
   g_object_set (self, "password", password, NULL);
 }
 
+/**
+ * epc_consumer_set_endpoint_cache:
+ * @consumer: a #EpcConsumer
+ * @filename: file name of the endpoint cache, or %NULL
+ *
+ * Changes the file used for caching the endpoints of publishers.
+ * Set it right after creating the consumer, as the cached endpoint
+ * is only used before the first request is sent.
+ * See #EpcConsumer:endpoint-cache for details.
+ *
+ * Since: 1.10
+ */
+void
+epc_consumer_set_endpoint_cache (EpcConsumer *self,
+                                 const gchar *filename)
+{
+  g_return_if_fail (EPC_IS_CONSUMER (self));
+  g_object_set (self, "endpoint-cache", filename, NULL);
+}
+
 /**
  * epc_consumer_get_protocol:
  * @consumer: a #EpcConsumer
@@ -783,6 +1481,24 @@ epc_consumer_get_password (EpcConsumer *self)
   return self->priv->password;
 }
 
+/**
+ * epc_consumer_get_endpoint_cache:
+ * @consumer: a #EpcConsumer
+ *
+ * Queries the file used for caching the endpoints of publishers.
+ * See #EpcConsumer:endpoint-cache for details.
+ *
+ * Returns: The file name of the endpoint cache, or %NULL.
+ *
+ * Since: 1.10
+ */
+const gchar*
+epc_consumer_get_endpoint_cache (EpcConsumer *self)
+{
+  g_return_val_if_fail (EPC_IS_CONSUMER (self), NULL);
+  return self->priv->endpoint_cache;
+}
+
 static gboolean
 epc_consumer_wait_cb (gpointer data)
 {
@@ -830,6 +1546,9 @@ epc_consumer_resolve_publisher (EpcConsumer *self,
  * Checks if the host name of this consumer's #EpcPublisher
  * has been resolved already.
  *
+ * Endpoints taken from the #EpcConsumer:endpoint-cache count
+ * as resolved, until contacting them fails.
+ *
  * See also: epc_consumer_resolve_publisher(), #EpcPublisher::publisher-resolved
  *
  * Returns: %TRUE when the host name has been resolved, and %FALSE otherwise.
@@ -889,6 +1608,181 @@ epc_consumer_set_http_error (GError     **error,
                status, details);
 }
 
+/* Redirects @request to the publisher's current endpoint,
+ * after the endpoint it was created for has failed.
+ */
+static void
+epc_consumer_retarget_request (EpcConsumer *self,
+                               SoupMessage *request,
+                               const gchar *old_path)
+{
+  SoupURI *uri = soup_uri_copy (soup_message_get_uri (request));
+  gsize length = strlen (old_path);
+
+  soup_uri_set_scheme (uri, epc_protocol_get_uri_scheme (self->priv->protocol));
+  soup_uri_set_host (uri, self->priv->hostname);
+  soup_uri_set_port (uri, self->priv->port);
+
+  /* Lookup requests are relative to the publisher's contents path. */
+  if (0 == strncmp (uri->path, old_path, length) && '/' == uri->path[length])
+    {
+      gchar *path = g_strconcat (self->priv->path, uri->path + length, NULL);
+      soup_uri_set_path (uri, path);
+      g_free (path);
+    }
+
+  if (EPC_DEBUG_LEVEL (1))
+    {
+      gchar *request_uri = soup_uri_to_string (uri, FALSE);
+      g_debug ("%s: Retrying with `%s'", G_STRLOC, request_uri);
+      g_free (request_uri);
+    }
+
+  soup_message_set_uri (request, uri);
+  soup_uri_free (uri);
+}
+
+/* Sends @request synchronously. Requests failing for a cached endpoint
+ * are repeated for the endpoint found by service discovery.
+ */
+static guint
+epc_consumer_send_message (EpcConsumer *self,
+                           SoupMessage *request)
+{
+  gboolean optimistic = self->priv->optimistic;
+
+  epc_consumer_guard_request (self, request);
+  soup_session_send_message (self->priv->session, request);
+
+  if (optimistic && epc_consumer_endpoint_failed (request))
+    {
+      gchar *old_path = g_strdup (self->priv->path);
+
+      if (self->priv->optimistic)
+        epc_consumer_forget_endpoint (self);
+
+      if (epc_consumer_resolve_publisher (self, EPC_CONSUMER_DEFAULT_TIMEOUT))
+        {
+          epc_consumer_retarget_request (self, request, old_path);
+          epc_consumer_guard_request (self, request);
+          soup_session_send_message (self->priv->session, request);
+        }
+      else
+        soup_message_set_status (request, SOUP_STATUS_CANT_RESOLVE);
+
+      g_free (old_path);
+    }
+
+  epc_consumer_remember_certificate (self, request);
+
+  return request->status_code;
+}
+
+/* Like epc_consumer_send_message(), but for streaming responses. */
+static GInputStream*
+epc_consumer_send_stream (EpcConsumer   *self,
+                          SoupMessage   *request,
+                          GCancellable  *cancellable,
+                          GError       **error)
+{
+  gboolean optimistic = self->priv->optimistic;
+  GError *send_error = NULL;
+  GInputStream *stream;
+
+  epc_consumer_guard_request (self, request);
+  stream = soup_session_send (self->priv->session, request, cancellable, &send_error);
+
+  if (optimistic && !g_cancellable_is_cancelled (cancellable) &&
+      (!stream || epc_consumer_endpoint_failed (request)))
+    {
+      gchar *old_path = g_strdup (self->priv->path);
+
+      if (stream)
+        {
+          g_input_stream_close (stream, NULL, NULL);
+          g_clear_object (&stream);
+        }
+
+      g_clear_error (&send_error);
+
+      if (self->priv->optimistic)
+        epc_consumer_forget_endpoint (self);
+
+      if (epc_consumer_resolve_publisher (self, EPC_CONSUMER_DEFAULT_TIMEOUT))
+        {
+          epc_consumer_retarget_request (self, request, old_path);
+          epc_consumer_guard_request (self, request);
+          stream = soup_session_send (self->priv->session, request, cancellable, &send_error);
+        }
+      else
+        epc_consumer_set_http_error (&send_error, NULL, SOUP_STATUS_CANT_RESOLVE);
+
+      g_free (old_path);
+    }
+
+  if (stream)
+    epc_consumer_remember_certificate (self, request);
+  else
+    g_propagate_error (error, send_error);
+
+  return stream;
+}
+
+static SoupMessage*
+epc_consumer_build_lookup_request (EpcConsumer *self,
+                                   const gchar *key)
+{
+  SoupMessage *request;
+  gchar *keyuri;
+  gchar *path;
+
+  keyuri = soup_uri_encode (key, NULL);
+  path = g_strconcat (self->priv->path, "/", keyuri, NULL);
+  request = epc_consumer_create_request (self, path);
+
+  g_free (keyuri);
+  g_free (path);
+
+  return request;
+}
+
+static SoupMessage*
+epc_consumer_create_lookup_request (EpcConsumer *self,
+                                    const gchar *key)
+{
+  if (epc_consumer_resolve_publisher (self, EPC_CONSUMER_DEFAULT_TIMEOUT))
+    return epc_consumer_build_lookup_request (self, key);
+
+  return NULL;
+}
+
+static gpointer
+epc_consumer_copy_data (gconstpointer  data,
+                        gsize          size,
+                        gsize         *length)
+{
+  gchar *contents;
+
+  if (length)
+    *length = size;
+
+  contents = g_malloc (size + 1);
+  contents[size] = '\0';
+
+  memcpy (contents, data, size);
+
+  return contents;
+}
+
+static gpointer
+epc_consumer_copy_response (SoupMessage *request,
+                            gsize       *length)
+{
+  return epc_consumer_copy_data (request->response_body->data,
+                                 request->response_body->length,
+                                 length);
+}
+
 /**
  * epc_consumer_lookup:
  * @consumer: the consumer
@@ -927,36 +1821,332 @@ epc_consumer_lookup (EpcConsumer  *self,
   g_return_val_if_fail (EPC_IS_CONSUMER (self), NULL);
   g_return_val_if_fail (NULL != key, NULL);
 
-  if (epc_consumer_resolve_publisher (self, EPC_CONSUMER_DEFAULT_TIMEOUT))
-    {
-      gchar *keyuri = NULL;
-      gchar *path = NULL;
+  request = epc_consumer_create_lookup_request (self, key);
 
-      keyuri = soup_uri_encode (key, NULL);
-      path = g_strconcat (self->priv->path, "/", keyuri, NULL);
-      request = epc_consumer_create_request (self, path);
+  if (request)
+    status = epc_consumer_send_message (self, request);
+  else
+    status = SOUP_STATUS_CANT_RESOLVE;
 
-      g_free (keyuri);
-      g_free (path);
+  if (SOUP_STATUS_IS_SUCCESSFUL (status))
+    contents = epc_consumer_copy_response (request, length);
+  else
+    epc_consumer_set_http_error (error, request, status);
+
+  if (request)
+    g_object_unref (request);
+
+  return contents;
+}
+
+/**
+ * epc_consumer_lookup_bytes:
+ * @consumer: the consumer
+ * @key: unique key of the value
+ * @error: return location for a #GError, or %NULL
+ *
+ * Retrieves the value the publisher provides for @key like
+ * epc_consumer_lookup() does, but returns the response body of the
+ * HTTP library directly instead of copying it. This avoids the copy
+ * for large values. Unlike the buffer returned by epc_consumer_lookup()
+ * the data of the #GBytes is not nul-terminated.
+ *
+ * Errors are reported like for epc_consumer_lookup().
+ *
+ * Returns: A #GBytes holding the publisher's value for the the requested
+ * @key, or %NULL when an error occurred. Release it with g_bytes_unref()
+ * when no longer needed.
+ *
+ * Since: 1.10
+ */
+GBytes*
+epc_consumer_lookup_bytes (EpcConsumer  *self,
+                           const gchar  *key,
+                           GError      **error)
+{
+  SoupMessage *request = NULL;
+  GBytes *contents = NULL;
+  gint status = 0;
+
+  g_return_val_if_fail (EPC_IS_CONSUMER (self), NULL);
+  g_return_val_if_fail (NULL != key, NULL);
+
+  request = epc_consumer_create_lookup_request (self, key);
+
+  if (request)
+    status = epc_consumer_send_message (self, request);
+  else
+    status = SOUP_STATUS_CANT_RESOLVE;
+
+  if (SOUP_STATUS_IS_SUCCESSFUL (status))
+    {
+      SoupBuffer *buffer = soup_message_body_flatten (request->response_body);
+
+      contents = soup_buffer_get_as_bytes (buffer);
+      soup_buffer_free (buffer);
     }
+  else
+    epc_consumer_set_http_error (error, request, status);
+
+  if (request)
+    g_object_unref (request);
+
+  return contents;
+}
+
+/**
+ * epc_consumer_lookup_range:
+ * @consumer: the consumer
+ * @key: unique key of the value
+ * @offset: position of the first byte to retrieve
+ * @length: number of bytes to retrieve, or -1 for retrieving all remaining bytes
+ * @received: location to store the number of bytes retrieved, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Retrieves a window of the value the publisher provides for @key, without
+ * downloading the entire value. This is useful for resuming interrupted
+ * transfers, or for inspecting the header of large binary values.
+ *
+ * Less than @length bytes are returned when the value ends before. When
+ * @offset is beyond the end of the value, %NULL is returned and @error is
+ * set to #SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE. Other errors are
+ * reported like for epc_consumer_lookup().
+ *
+ * The returned buffer should be freed when no longer needed.
+ *
+ * Returns: A copy of the requested window of the publisher's value for
+ * @key, or %NULL when an error occurred.
+ *
+ * Since: 1.10
+ */
+gpointer
+epc_consumer_lookup_range (EpcConsumer  *self,
+                           const gchar  *key,
+                           goffset       offset,
+                           gssize        length,
+                           gsize        *received,
+                           GError      **error)
+{
+  SoupMessage *request = NULL;
+  gchar *contents = NULL;
+  gint status = 0;
+
+  g_return_val_if_fail (EPC_IS_CONSUMER (self), NULL);
+  g_return_val_if_fail (NULL != key, NULL);
+  g_return_val_if_fail (offset >= 0, NULL);
+
+  request = epc_consumer_create_lookup_request (self, key);
 
   if (request)
-    status = soup_session_send_message (self->priv->session, request);
+    {
+      if (0 == length)
+        soup_message_headers_set_range (request->request_headers, offset, offset);
+      else
+        soup_message_headers_set_range (request->request_headers, offset,
+                                        length < 0 ? -1 : offset + length - 1);
+
+      /* Ranges of compressed responses refer to the compressed
+       * representation, so request the value as it is. */
+      soup_message_disable_feature (request, SOUP_TYPE_CONTENT_DECODER);
+
+      status = epc_consumer_send_message (self, request);
+    }
   else
     status = SOUP_STATUS_CANT_RESOLVE;
 
+  /* Publishers don't support ranges for streams, and return the entire
+   * value then. Therefore the window is cut out locally in that case. */
+  if (SOUP_STATUS_OK == status && offset >= (goffset) request->response_body->length)
+    status = SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE;
+
   if (SOUP_STATUS_IS_SUCCESSFUL (status))
     {
-      const gsize response_length = request->response_body->length;
-      gconstpointer response_data = request->response_body->data;
+      const gchar *data = request->response_body->data;
+      gsize size = request->response_body->length;
+
+      if (SOUP_STATUS_OK == status)
+        {
+          data += offset;
+          size -= offset;
+        }
+
+      if (length >= 0)
+        size = MIN (size, (gsize) length);
+
+      contents = epc_consumer_copy_data (data, size, received);
+    }
+  else if (request && request->status_code != (guint) status)
+    epc_consumer_set_http_error (error, NULL, status);
+  else
+    epc_consumer_set_http_error (error, request, status);
+
+  if (request)
+    g_object_unref (request);
+
+  return contents;
+}
+
+/**
+ * epc_consumer_lookup_stream:
+ * @consumer: the consumer
+ * @key: unique key of the value
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Opens a stream for reading the value the publisher provides for @key.
+ * Unlike epc_consumer_lookup() this function doesn't accumulate the value
+ * in memory, the data is delivered while it arrives from the network.
+ * This keeps memory usage low for very large values, like streams created
+ * by the publisher with epc_contents_stream_new().
+ *
+ * If the call was not successful it returns %NULL and sets @error.
+ * HTTP errors are reported like for epc_consumer_lookup(), errors while
+ * reading the stream are reported by the #GInputStream.
+ *
+ * See also: epc_consumer_lookup_to_stream()
+ *
+ * Returns: A new #GInputStream, or %NULL when an error occurred.
+ * Release it with g_object_unref() when no longer needed.
+ *
+ * Since: 1.10
+ */
+GInputStream*
+epc_consumer_lookup_stream (EpcConsumer   *self,
+                            const gchar   *key,
+                            GCancellable  *cancellable,
+                            GError       **error)
+{
+  GInputStream *stream = NULL;
+  SoupMessage *request;
+
+  g_return_val_if_fail (EPC_IS_CONSUMER (self), NULL);
+  g_return_val_if_fail (NULL != key, NULL);
+
+  request = epc_consumer_create_lookup_request (self, key);
+
+  if (!request)
+    {
+      epc_consumer_set_http_error (error, NULL, SOUP_STATUS_CANT_RESOLVE);
+      return NULL;
+    }
+
+  stream = epc_consumer_send_stream (self, request, cancellable, error);
+
+  if (stream && !SOUP_STATUS_IS_SUCCESSFUL (request->status_code))
+    {
+      epc_consumer_set_http_error (error, request, request->status_code);
+      g_input_stream_close (stream, NULL, NULL);
+      g_clear_object (&stream);
+    }
+
+  g_object_unref (request);
+
+  return stream;
+}
+
+/**
+ * epc_consumer_lookup_to_stream:
+ * @consumer: the consumer
+ * @key: unique key of the value
+ * @output: the #GOutputStream receiving the value
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the value the publisher provides for @key to @output while it
+ * arrives from the network, without keeping the value in memory. The
+ * @output stream is not closed. See epc_consumer_lookup_stream() for
+ * details.
+ *
+ * Returns: The number of bytes written to @output, or -1 when an error
+ * occurred.
+ *
+ * Since: 1.10
+ */
+gssize
+epc_consumer_lookup_to_stream (EpcConsumer    *self,
+                               const gchar    *key,
+                               GOutputStream  *output,
+                               GCancellable   *cancellable,
+                               GError        **error)
+{
+  GInputStream *input;
+  gssize length;
+
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (output), -1);
+
+  input = epc_consumer_lookup_stream (self, key, cancellable, error);
+
+  if (!input)
+    return -1;
+
+  length = g_output_stream_splice (output, input,
+                                   G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE,
+                                   cancellable, error);
+
+  g_object_unref (input);
+
+  return length;
+}
+
+/**
+ * epc_consumer_revalidate:
+ * @consumer: the consumer
+ * @key: unique key of the value
+ * @etag: location of the entity tag of a previously retrieved value
+ * @length: location to store length in bytes of the contents, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Retrieves the value the publisher provides for @key, but only if it
+ * differs from the value identified by the entity tag stored in @etag.
+ * Pass a pointer to %NULL for @etag on the first call. On success the
+ * new value is returned like epc_consumer_lookup() does, and @etag is
+ * updated with the entity tag of that value. The entity tag should be
+ * freed when no longer needed.
+ *
+ * When the value didn't change, %NULL is returned and @error is set to
+ * #SOUP_STATUS_NOT_MODIFIED within the #EPC_HTTP_ERROR domain. Other
+ * errors are reported like for epc_consumer_lookup().
+ *
+ * This allows polling a value without downloading it again and again.
+ *
+ * Returns: A copy of the publisher's value for the the requested @key,
+ * or %NULL when the value didn't change or an error occurred.
+ *
+ * Since: 1.10
+ */
+gpointer
+epc_consumer_revalidate (EpcConsumer  *self,
+                         const gchar  *key,
+                         gchar       **etag,
+                         gsize        *length,
+                         GError      **error)
+{
+  SoupMessage *request = NULL;
+  gchar *contents = NULL;
+  gint status = 0;
+
+  g_return_val_if_fail (EPC_IS_CONSUMER (self), NULL);
+  g_return_val_if_fail (NULL != etag, NULL);
+  g_return_val_if_fail (NULL != key, NULL);
+
+  request = epc_consumer_create_lookup_request (self, key);
+
+  if (request)
+    {
+      if (*etag)
+        soup_message_headers_replace (request->request_headers, "If-None-Match", *etag);
 
-      if (length)
-        *length = response_length;
+      status = epc_consumer_send_message (self, request);
+    }
+  else
+    status = SOUP_STATUS_CANT_RESOLVE;
 
-      contents = g_malloc (response_length + 1);
-      contents[response_length] = '\0';
+  if (SOUP_STATUS_IS_SUCCESSFUL (status))
+    {
+      contents = epc_consumer_copy_response (request, length);
 
-      memcpy (contents, response_data, response_length);
+      g_free (*etag);
+      *etag = g_strdup (soup_message_headers_get_one (request->response_headers, "ETag"));
     }
   else
     epc_consumer_set_http_error (error, request, status);
@@ -970,19 +2160,29 @@ epc_consumer_lookup (EpcConsumer  *self,
 static void
 epc_consumer_list_parser_start_element (GMarkupParseContext *context G_GNUC_UNUSED,
                                         const gchar         *element_name,
-                                        const gchar        **attribute_names G_GNUC_UNUSED,
-                                        const gchar        **attribute_values G_GNUC_UNUSED,
+                                        const gchar        **attribute_names,
+                                        const gchar        **attribute_values,
                                         gpointer             data,
                                         GError             **error)
 {
   EpcListingElementType element = EPC_LISTING_ELEMENT_NONE;
   EpcListingState *state = data;
+  gint i;
 
   switch (state->element)
     {
       case EPC_LISTING_ELEMENT_NONE:
         if (g_str_equal (element_name, "list"))
-          element = EPC_LISTING_ELEMENT_LIST;
+          {
+            element = EPC_LISTING_ELEMENT_LIST;
+
+            for (i = 0; attribute_names[i]; ++i)
+              if (g_str_equal (attribute_names[i], "continue"))
+                {
+                  g_free (state->continuation);
+                  state->continuation = g_strdup (attribute_values[i]);
+                }
+          }
 
         break;
 
@@ -1077,11 +2277,183 @@ epc_consumer_list_parser_text (GMarkupParseContext *context G_GNUC_UNUSED,
     }
 }
 
-/**
- * epc_consumer_list:
- * @consumer: a #EpcConsumer
- * @pattern: a glob-style pattern, or %NULL
- * @error: return location for a #GError, or %NULL
+/* Builds a request for the keys matching @pattern. Only the keys sorting
+ * behind @after are requested, when @after is not %NULL. Pages are limited
+ * to @limit keys, or to the publisher's default page size when @limit is
+ * zero.
+ */
+static SoupMessage*
+epc_consumer_build_list_request (EpcConsumer *self,
+                                 const gchar *pattern,
+                                 const gchar *after,
+                                 guint        limit)
+{
+  SoupMessage *request;
+  gchar *patternuri;
+  gchar *query = NULL;
+  gchar *path;
+
+  if (limit > 0)
+    {
+      gchar *limit_str = g_strdup_printf ("%u", limit);
+
+      if (after)
+        query = soup_form_encode ("limit", limit_str, "after", after, NULL);
+      else
+        query = soup_form_encode ("limit", limit_str, NULL);
+
+      g_free (limit_str);
+    }
+  else if (after)
+    query = soup_form_encode ("after", after, NULL);
+
+  /* Escape the pattern, as jokers would introduce a query string. */
+  patternuri = (pattern ? soup_uri_encode (pattern, NULL) : NULL);
+  path = g_strconcat ("/list/", patternuri ? patternuri : "",
+                      query ? "?" : NULL, query, NULL);
+  request = epc_consumer_create_request (self, path);
+
+  /* Prefer the compact listing format, but still
+   * accept markup from publishers not supporting it. */
+  if (request)
+    soup_message_headers_replace (request->request_headers, "Accept",
+                                  EPC_LISTING_MIME_TYPE ", text/xml;q=0.5");
+
+  g_free (patternuri);
+  g_free (query);
+  g_free (path);
+
+  return request;
+}
+
+static void
+epc_consumer_free_items (gpointer data)
+{
+  g_list_foreach (data, (GFunc) g_free, NULL);
+  g_list_free (data);
+}
+
+static GList*
+epc_consumer_parse_markup_listing (const gchar  *data,
+                                   gsize         length,
+                                   gchar       **continuation,
+                                   GError      **error)
+{
+  GMarkupParseContext *context;
+  EpcListingState state;
+  GMarkupParser parser;
+
+  memset (&state, 0, sizeof state);
+  memset (&parser, 0, sizeof parser);
+
+  parser.start_element = epc_consumer_list_parser_start_element;
+  parser.end_element = epc_consumer_list_parser_end_element;
+  parser.text = epc_consumer_list_parser_text;
+
+  context = g_markup_parse_context_new (&parser,
+                                        G_MARKUP_TREAT_CDATA_AS_TEXT,
+                                        &state, NULL);
+
+  g_markup_parse_context_parse (context, data, length, error);
+  g_markup_parse_context_free (context);
+
+  if (state.name)
+    g_string_free (state.name, TRUE);
+
+  if (continuation)
+    *continuation = state.continuation;
+  else
+    g_free (state.continuation);
+
+  return state.items;
+}
+
+/* Parses listings in the compact format, which is a sequence
+ * of UTF-8 encoded keys, each prefixed by its length as 32 bit
+ * unsigned integer in network byte order.
+ */
+static GList*
+epc_consumer_parse_binary_listing (const gchar  *data,
+                                   gsize         length,
+                                   GError      **error)
+{
+  GList *items = NULL;
+  guint32 size;
+
+  while (length > 0)
+    {
+      if (length < sizeof size)
+        break;
+
+      memcpy (&size, data, sizeof size);
+      size = GUINT32_FROM_BE (size);
+
+      data += sizeof size;
+      length -= sizeof size;
+
+      if (length < size || !g_utf8_validate (data, size, NULL))
+        break;
+
+      items = g_list_prepend (items, g_strndup (data, size));
+
+      data += size;
+      length -= size;
+    }
+
+  if (length > 0)
+    {
+      epc_consumer_set_http_error (error, NULL, SOUP_STATUS_MALFORMED);
+      epc_consumer_free_items (items);
+      items = NULL;
+    }
+
+  return items;
+}
+
+/* Parses the listing received by @message. The returned list of keys is
+ * in reverse order. When @continuation is not %NULL, it receives the key to
+ * pass as "after" argument when requesting the next page of the listing.
+ */
+static GList*
+epc_consumer_parse_listing (SoupMessage  *message,
+                            gchar       **continuation,
+                            GError      **error)
+{
+  const gchar *content_type;
+
+  content_type = soup_message_headers_get_content_type (message->response_headers, NULL);
+
+  if (content_type && g_str_equal (content_type, EPC_LISTING_MIME_TYPE))
+    {
+      GList *items;
+
+      items = epc_consumer_parse_binary_listing (message->response_body->data,
+                                                 message->response_body->length,
+                                                 error);
+
+      if (continuation)
+        {
+          const gchar *keyuri;
+
+          keyuri = soup_message_headers_get_one (message->response_headers,
+                                                 "X-Epc-Continue");
+
+          *continuation = (items && keyuri ? soup_uri_decode (keyuri) : NULL);
+        }
+
+      return items;
+    }
+
+  return epc_consumer_parse_markup_listing (message->response_body->data,
+                                            message->response_body->length,
+                                            continuation, error);
+}
+
+/**
+ * epc_consumer_list:
+ * @consumer: a #EpcConsumer
+ * @pattern: a glob-style pattern, or %NULL
+ * @error: return location for a #GError, or %NULL
  *
  * Matches published keys against patterns containing '*' (wildcard) and '?'
  * (joker). Passing %NULL as @pattern is equivalent to passing "*" and returns
@@ -1089,6 +2461,14 @@ epc_consumer_list_parser_text (GMarkupParseContext *context G_GNUC_UNUSED,
  * published values. See #GPatternSpec for information about glob-style
  * patterns.
  *
+ * Matching is done by the publisher, so only the matching keys are
+ * transferred. Prefer specific patterns over filtering the list of all
+ * keys when just a few of many published keys are of interest.
+ *
+ * Publishers send large listings in pages, which are requested one after
+ * another. Use epc_consumer_list_cursor_new() to process the keys without
+ * holding all of them in memory.
+ *
  * If the call was successful, a list of keys matching @pattern is returned.
  * If the call was not successful, it returns %NULL and sets @error.
  * The error domain is #EPC_HTTP_ERROR. Error codes are taken from the
@@ -1107,11 +2487,277 @@ epc_consumer_list_parser_text (GMarkupParseContext *context G_GNUC_UNUSED,
  */
 GList*
 epc_consumer_list (EpcConsumer  *self,
-                   const gchar  *pattern G_GNUC_UNUSED,
-                   GError      **error G_GNUC_UNUSED)
+                   const gchar  *pattern,
+                   GError      **error)
 {
+  gchar *continuation = NULL;
+  GList *items = NULL;
+
+  g_return_val_if_fail (EPC_IS_CONSUMER (self), NULL);
+  g_return_val_if_fail (NULL == pattern || *pattern, NULL);
+
+  /* Publishers send large listings in pages. */
+  do
+    {
+      SoupMessage *request = NULL;
+      GError *parse_error = NULL;
+      gchar *next = NULL;
+      GList *page = NULL;
+      gint status = 0;
+
+      if (epc_consumer_resolve_publisher (self, EPC_CONSUMER_DEFAULT_TIMEOUT))
+        request = epc_consumer_build_list_request (self, pattern, continuation, 0);
+
+      if (request)
+        status = epc_consumer_send_message (self, request);
+      else
+        status = SOUP_STATUS_CANT_RESOLVE;
+
+      if (SOUP_STATUS_IS_SUCCESSFUL (status))
+        page = epc_consumer_parse_listing (request, &next, &parse_error);
+      else
+        epc_consumer_set_http_error (&parse_error, request, status);
+
+      if (request)
+        g_object_unref (request);
+
+      if (parse_error)
+        {
+          g_propagate_error (error, parse_error);
+          epc_consumer_free_items (page);
+          epc_consumer_free_items (items);
+          g_free (continuation);
+          g_free (next);
+
+          return NULL;
+        }
+
+      /* Both lists are in reverse order. */
+      items = g_list_concat (page, items);
+
+      /* Protect against publishers not making progress. */
+      if (next && continuation && strcmp (next, continuation) <= 0)
+        {
+          g_free (next);
+          next = NULL;
+        }
+
+      g_free (continuation);
+      continuation = next;
+    }
+  while (continuation);
+
+  return items;
+}
+
+/**
+ * epc_consumer_list_cursor_new:
+ * @consumer: a #EpcConsumer
+ * @pattern: a glob-style pattern, or %NULL
+ * @page_size: the maximum number of keys to retrieve per request
+ *
+ * Creates a cursor for iterating the published keys matching @pattern.
+ * See epc_consumer_list() for a description of @pattern. Other than
+ * epc_consumer_list() the cursor retrieves the keys lazily in pages
+ * of at most @page_size keys, so that listing publishers with huge
+ * numbers of keys doesn't require huge amounts of memory.
+ *
+ * Keys are reported in byte order. Keys published or removed while
+ * iterating are reported when they sort behind the current position
+ * of the cursor.
+ *
+ * <example id="iterate-keys">
+ *  <title>Iterate all published keys</title>
+ *  <programlisting>
+ *   EpcListCursor *cursor;
+ *   const gchar *key;
+ *
+ *   cursor = epc_consumer_list_cursor_new (consumer, NULL, 500);
+ *
+ *   while (NULL != (key = epc_list_cursor_next (cursor, &error)))
+ *     process_key (key);
+ *
+ *   epc_list_cursor_free (cursor);
+ *  </programlisting>
+ * </example>
+ *
+ * Returns: The newly created cursor. Free with epc_list_cursor_free().
+ *
+ * Since: 1.10
+ */
+EpcListCursor*
+epc_consumer_list_cursor_new (EpcConsumer *consumer,
+                              const gchar *pattern,
+                              guint        page_size)
+{
+  EpcListCursor *cursor;
+
+  g_return_val_if_fail (EPC_IS_CONSUMER (consumer), NULL);
+  g_return_val_if_fail (NULL == pattern || *pattern, NULL);
+  g_return_val_if_fail (page_size > 0, NULL);
+
+  cursor = g_slice_new0 (EpcListCursor);
+
+  cursor->consumer = g_object_ref (consumer);
+  cursor->pattern = g_strdup (pattern);
+  cursor->page_size = page_size;
+
+  return cursor;
+}
+
+static gboolean
+epc_list_cursor_fetch (EpcListCursor  *cursor,
+                       GError        **error)
+{
+  EpcConsumer *self = cursor->consumer;
   SoupMessage *request = NULL;
-  EpcListingState state;
+  gchar *continuation = NULL;
+  GError *parse_error = NULL;
+  GList *items = NULL;
+  gint status = 0;
+
+  if (epc_consumer_resolve_publisher (self, EPC_CONSUMER_DEFAULT_TIMEOUT))
+    request = epc_consumer_build_list_request (self, cursor->pattern,
+                                              cursor->continuation,
+                                              cursor->page_size);
+
+  if (request)
+    status = epc_consumer_send_message (self, request);
+  else
+    status = SOUP_STATUS_CANT_RESOLVE;
+
+  if (SOUP_STATUS_IS_SUCCESSFUL (status))
+    items = epc_consumer_parse_listing (request, &continuation, &parse_error);
+  else
+    epc_consumer_set_http_error (error, request, status);
+
+  if (request)
+    g_object_unref (request);
+
+  if (parse_error)
+    {
+      g_propagate_error (error, parse_error);
+      epc_consumer_free_items (items);
+      g_free (continuation);
+
+      return FALSE;
+    }
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (status))
+    return FALSE;
+
+  /* Protect against publishers not making progress. */
+  if (continuation && cursor->continuation &&
+      strcmp (continuation, cursor->continuation) <= 0)
+    {
+      g_free (continuation);
+      continuation = NULL;
+    }
+
+  g_free (cursor->continuation);
+  cursor->continuation = continuation;
+  cursor->page = g_list_reverse (items);
+  cursor->started = TRUE;
+
+  return TRUE;
+}
+
+/**
+ * epc_list_cursor_next:
+ * @cursor: a #EpcListCursor
+ * @error: return location for a #GError, or %NULL
+ *
+ * Advances @cursor to the next matching key. The next page of keys is
+ * retrieved from the publisher when all keys of the current page have been
+ * consumed. Errors are reported like for epc_consumer_list(). Calling this
+ * function again after an error retries the failed request.
+ *
+ * Returns: The next matching key, or %NULL when all keys have been
+ * reported or an error occurred. The string is owned by @cursor and
+ * remains valid until the next call of this function.
+ *
+ * Since: 1.10
+ */
+const gchar*
+epc_list_cursor_next (EpcListCursor  *cursor,
+                      GError        **error)
+{
+  g_return_val_if_fail (NULL != cursor, NULL);
+
+  g_free (cursor->current);
+  cursor->current = NULL;
+
+  while (!cursor->page && (!cursor->started || cursor->continuation))
+    if (!epc_list_cursor_fetch (cursor, error))
+      return NULL;
+
+  if (cursor->page)
+    {
+      cursor->current = cursor->page->data;
+      cursor->page = g_list_delete_link (cursor->page, cursor->page);
+    }
+
+  return cursor->current;
+}
+
+/**
+ * epc_list_cursor_free:
+ * @cursor: a #EpcListCursor
+ *
+ * Releases all resources held by @cursor.
+ *
+ * Since: 1.10
+ */
+void
+epc_list_cursor_free (EpcListCursor *cursor)
+{
+  if (!cursor)
+    return;
+
+  epc_consumer_free_items (cursor->page);
+  g_object_unref (cursor->consumer);
+
+  g_free (cursor->continuation);
+  g_free (cursor->current);
+  g_free (cursor->pattern);
+
+  g_slice_free (EpcListCursor, cursor);
+}
+
+/**
+ * epc_consumer_lookup_many:
+ * @consumer: a #EpcConsumer
+ * @pattern: a glob-style pattern, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Retrieves the values of all published keys matching @pattern within a
+ * single request. See epc_consumer_list() for a description of @pattern.
+ * This is much faster than calling epc_consumer_lookup() for each key when
+ * retrieving many small values.
+ *
+ * Keys with an authentication handler rejecting the credentials of
+ * @consumer are omitted from the result, as are keys for which the
+ * publisher provides no value.
+ *
+ * If the call was successful, a hash table mapping the keys to #GBytes
+ * holding their values is returned. If the call was not successful,
+ * it returns %NULL and sets @error. Errors are reported like for
+ * epc_consumer_lookup().
+ *
+ * The returned hash table should be released with g_hash_table_unref()
+ * when no longer needed.
+ *
+ * Returns: A newly created hash table, or %NULL when an error occurred.
+ *
+ * Since: 1.10
+ */
+GHashTable*
+epc_consumer_lookup_many (EpcConsumer  *self,
+                          const gchar  *pattern,
+                          GError      **error)
+{
+  SoupMessage *request = NULL;
+  GHashTable *values = NULL;
   gint status = 0;
 
   g_return_val_if_fail (EPC_IS_CONSUMER (self), NULL);
@@ -1119,47 +2765,522 @@ epc_consumer_list (EpcConsumer  *self,
 
   if (epc_consumer_resolve_publisher (self, EPC_CONSUMER_DEFAULT_TIMEOUT))
     {
-      gchar *path = g_strconcat ("/list/", pattern, NULL);
+      gchar *patternuri = (pattern ? soup_uri_encode (pattern, NULL) : NULL);
+      gchar *path = g_strconcat ("/batch/", patternuri, NULL);
+
       request = epc_consumer_create_request (self, path);
+
+      /* Publishers only ask for credentials when told that we have some. */
+      if (request)
+        soup_message_headers_replace (request->request_headers,
+                                      "X-Epc-Authenticate", "1");
+
+      g_free (patternuri);
       g_free (path);
     }
 
   if (request)
-    status = soup_session_send_message (self->priv->session, request);
+    status = epc_consumer_send_message (self, request);
   else
     status = SOUP_STATUS_CANT_RESOLVE;
 
-  memset (&state, 0, sizeof state);
-
   if (SOUP_STATUS_IS_SUCCESSFUL (status))
     {
-      GMarkupParseContext *context;
-      GMarkupParser parser;
+      SoupMultipart *multipart;
+      int i;
+
+      multipart = soup_multipart_new_from_message (request->response_headers,
+                                                   request->response_body);
+
+      if (multipart)
+        {
+          values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify) g_bytes_unref);
+
+          for (i = 0; i < soup_multipart_get_length (multipart); ++i)
+            {
+              SoupMessageHeaders *headers;
+              const gchar *keyuri;
+              SoupBuffer *body;
+
+              if (!soup_multipart_get_part (multipart, i, &headers, &body))
+                continue;
+
+              keyuri = soup_message_headers_get_one (headers, "X-Epc-Key");
+
+              /* The values reference the response buffer instead of
+               * copying it. */
+              if (keyuri)
+                g_hash_table_replace (values, soup_uri_decode (keyuri),
+                                      soup_buffer_get_as_bytes (body));
+            }
+
+          soup_multipart_free (multipart);
+        }
+      else
+        epc_consumer_set_http_error (error, NULL, SOUP_STATUS_MALFORMED);
+    }
+  else
+    epc_consumer_set_http_error (error, request, status);
 
-      memset (&parser, 0, sizeof parser);
+  if (request)
+    g_object_unref (request);
 
-      parser.start_element = epc_consumer_list_parser_start_element;
-      parser.end_element = epc_consumer_list_parser_end_element;
-      parser.text = epc_consumer_list_parser_text;
+  return values;
+}
 
-      context = g_markup_parse_context_new (&parser,
-                                            G_MARKUP_TREAT_CDATA_AS_TEXT,
-                                            &state, NULL);
+static void
+epc_consumer_async_request_free (gpointer data)
+{
+  EpcAsyncRequest *request = data;
 
-      g_markup_parse_context_parse (context,
-                                    request->response_body->data,
-                                    request->response_body->length,
-                                    error);
+  epc_consumer_free_items (request->items);
+  g_free (request->continuation);
+  g_free (request->argument);
+  g_slice_free (EpcAsyncRequest, request);
+}
 
-      g_markup_parse_context_free (context);
+static void
+epc_consumer_stop_pending_timeout (EpcConsumer *self)
+{
+  if (self->priv->pending_timeout)
+    {
+      g_source_destroy (self->priv->pending_timeout);
+      g_source_unref (self->priv->pending_timeout);
+      self->priv->pending_timeout = NULL;
+    }
+}
+
+static gboolean
+epc_consumer_cancel_idle_cb (gpointer data)
+{
+  GTask *task = data;
+  EpcConsumer *self = g_task_get_source_object (task);
+  EpcAsyncRequest *request = g_task_get_task_data (task);
+  GList *link = g_list_find (self->priv->pending_tasks, task);
+
+  /* Tasks still waiting for the publisher are completed right away. */
+  if (link)
+    {
+      self->priv->pending_tasks = g_list_delete_link (self->priv->pending_tasks, link);
+
+      g_cancellable_disconnect (g_task_get_cancellable (task), request->cancelled_id);
+      request->cancelled_id = 0;
+
+      if (!self->priv->pending_tasks)
+        epc_consumer_stop_pending_timeout (self);
+
+      g_task_return_error_if_cancelled (task);
+      g_object_unref (task);
+    }
+  else if (request->message && self->priv->session)
+    soup_session_cancel_message (self->priv->session,
+                                 request->message,
+                                 SOUP_STATUS_CANCELLED);
+
+  return FALSE;
+}
+
+static void
+epc_consumer_cancelled_cb (GCancellable *cancellable G_GNUC_UNUSED,
+                           gpointer      data)
+{
+  GSource *source = g_idle_source_new ();
+
+  /* The task must be cancelled from the main context it was queued in,
+   * and the cancellable must not be disconnected from within this handler. */
+  g_source_set_callback (source, epc_consumer_cancel_idle_cb,
+                         g_object_ref (data), g_object_unref);
+  g_source_attach (source, g_task_get_context (data));
+  g_source_unref (source);
+}
+
+static void epc_consumer_send_task (EpcConsumer *self,
+                                    GTask       *task);
+
+static void
+epc_consumer_task_done_cb (SoupSession *session G_GNUC_UNUSED,
+                           SoupMessage *message,
+                           gpointer     data)
+{
+  GTask *task = data;
+  EpcConsumer *self = g_task_get_source_object (task);
+  EpcAsyncRequest *request = g_task_get_task_data (task);
+  GCancellable *cancellable = g_task_get_cancellable (task);
+  GError *error = NULL;
+
+  request->message = NULL;
+
+  if (request->cancelled_id)
+    g_cancellable_disconnect (cancellable, request->cancelled_id);
+
+  request->cancelled_id = 0;
+
+  if (g_task_return_error_if_cancelled (task))
+    {
+      g_object_unref (task);
+      return;
+    }
+
+  /* Repeat requests failing for a cached endpoint,
+   * once service discovery has found the publisher. */
+  if (request->optimistic && epc_consumer_endpoint_failed (message))
+    {
+      if (self->priv->optimistic)
+        epc_consumer_forget_endpoint (self);
+
+      epc_consumer_queue_task (self, task);
+      return;
+    }
+
+  epc_consumer_remember_certificate (self, message);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (message->status_code))
+    {
+      epc_consumer_set_http_error (&error, message, message->status_code);
+      g_task_return_error (task, error);
+    }
+  else if (g_task_get_source_tag (task) == epc_consumer_list_async)
+    {
+      gchar *continuation = NULL;
+      GList *items;
+
+      items = epc_consumer_parse_listing (message, &continuation, &error);
+
+      if (error)
+        {
+          epc_consumer_free_items (items);
+          g_task_return_error (task, error);
+          g_free (continuation);
+        }
+      else
+        {
+          /* Both lists are in reverse order. */
+          request->items = g_list_concat (items, request->items);
+
+          /* Protect against publishers not making progress. */
+          if (continuation && request->continuation &&
+              strcmp (continuation, request->continuation) <= 0)
+            {
+              g_free (continuation);
+              continuation = NULL;
+            }
+
+          g_free (request->continuation);
+          request->continuation = continuation;
+
+          /* Request the next page of the listing. */
+          if (continuation)
+            {
+              epc_consumer_send_task (self, task);
+              return;
+            }
+
+          items = request->items;
+          request->items = NULL;
+
+          g_task_return_pointer (task, items, epc_consumer_free_items);
+        }
     }
   else
-    epc_consumer_set_http_error (error, request, status);
+    {
+      gsize length = 0;
+      gpointer contents;
 
-  if (request)
-    g_object_unref (request);
+      contents = epc_consumer_copy_response (message, &length);
+      g_task_return_pointer (task, g_bytes_new_take (contents, length),
+                             (GDestroyNotify) g_bytes_unref);
+    }
 
-  return state.items;
+  g_object_unref (task);
+}
+
+static void
+epc_consumer_send_task (EpcConsumer *self,
+                        GTask       *task)
+{
+  EpcAsyncRequest *request = g_task_get_task_data (task);
+  GCancellable *cancellable = g_task_get_cancellable (task);
+
+  if (g_task_return_error_if_cancelled (task))
+    {
+      g_object_unref (task);
+      return;
+    }
+
+  if (g_task_get_source_tag (task) == epc_consumer_list_async)
+    request->message = epc_consumer_build_list_request (self, request->argument,
+                                                        request->continuation, 0);
+  else
+    request->message = epc_consumer_build_lookup_request (self, request->argument);
+
+  request->optimistic = self->priv->optimistic;
+  epc_consumer_guard_request (self, request->message);
+
+  if (cancellable)
+    request->cancelled_id = g_cancellable_connect (cancellable,
+                                                   G_CALLBACK (epc_consumer_cancelled_cb),
+                                                   g_object_ref (task), g_object_unref);
+
+  soup_session_queue_message (self->priv->session, request->message,
+                              epc_consumer_task_done_cb, task);
+}
+
+static gboolean
+epc_consumer_send_task_cb (gpointer data)
+{
+  GTask *task = data;
+
+  epc_consumer_send_task (g_task_get_source_object (task), task);
+
+  return FALSE;
+}
+
+static void
+epc_consumer_flush_tasks (EpcConsumer *self)
+{
+  GList *tasks = self->priv->pending_tasks;
+  GList *iter;
+
+  self->priv->pending_tasks = NULL;
+  epc_consumer_stop_pending_timeout (self);
+
+  for (iter = tasks; iter; iter = iter->next)
+    {
+      GTask *task = iter->data;
+      EpcAsyncRequest *request = g_task_get_task_data (task);
+
+      if (request->cancelled_id)
+        g_cancellable_disconnect (g_task_get_cancellable (task),
+                                  request->cancelled_id);
+
+      request->cancelled_id = 0;
+
+      /* The message is queued in the caller's main context, so that libsoup
+       * processes it there, instead of in the context running the monitor. */
+      if (self->priv->hostname)
+        g_main_context_invoke (g_task_get_context (task),
+                               epc_consumer_send_task_cb, task);
+      else
+        {
+          GError *error = NULL;
+
+          epc_consumer_set_http_error (&error, NULL, SOUP_STATUS_CANT_RESOLVE);
+          g_task_return_error (task, error);
+          g_object_unref (task);
+        }
+    }
+
+  g_list_free (tasks);
+}
+
+static gboolean
+epc_consumer_pending_timeout_cb (gpointer data)
+{
+  EpcConsumer *self = data;
+
+  g_warning ("%s: Timeout reached when waiting for publisher", G_STRFUNC);
+
+  g_source_unref (self->priv->pending_timeout);
+  self->priv->pending_timeout = NULL;
+
+  epc_consumer_flush_tasks (self);
+
+  return FALSE;
+}
+
+/* Requests are sent immediately when the publisher is known. Otherwise they
+ * wait for the service monitor, without blocking the caller's main loop.
+ */
+static void
+epc_consumer_queue_task (EpcConsumer *self,
+                         GTask       *task)
+{
+  EpcAsyncRequest *request = g_task_get_task_data (task);
+  GCancellable *cancellable = g_task_get_cancellable (task);
+
+  if (self->priv->hostname)
+    {
+      epc_consumer_send_task (self, task);
+      return;
+    }
+
+  self->priv->pending_tasks = g_list_append (self->priv->pending_tasks, task);
+
+  if (cancellable)
+    request->cancelled_id = g_cancellable_connect (cancellable,
+                                                   G_CALLBACK (epc_consumer_cancelled_cb),
+                                                   g_object_ref (task), g_object_unref);
+
+  if (!self->priv->pending_timeout)
+    {
+      self->priv->pending_timeout = g_timeout_source_new (EPC_CONSUMER_DEFAULT_TIMEOUT);
+      g_source_set_callback (self->priv->pending_timeout,
+                             epc_consumer_pending_timeout_cb,
+                             self, NULL);
+      g_source_attach (self->priv->pending_timeout,
+                       g_task_get_context (task));
+    }
+}
+
+static GTask*
+epc_consumer_create_task (EpcConsumer         *self,
+                          const gchar         *argument,
+                          GCancellable        *cancellable,
+                          GAsyncReadyCallback  callback,
+                          gpointer             user_data,
+                          gpointer             source_tag)
+{
+  EpcAsyncRequest *request;
+  GTask *task;
+
+  request = g_slice_new0 (EpcAsyncRequest);
+  request->argument = g_strdup (argument);
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_task_data (task, request, epc_consumer_async_request_free);
+  g_task_set_source_tag (task, source_tag);
+
+  return task;
+}
+
+/**
+ * epc_consumer_lookup_async:
+ * @consumer: the consumer
+ * @key: unique key of the value
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously retrieves the value the publisher provides for @key.
+ * When the publisher has not been resolved yet, the request waits for
+ * the publisher without blocking the main loop. Any number of requests
+ * can be in flight for one consumer.
+ *
+ * The request is processed in the thread-default main context of the
+ * thread calling this function, and @callback is invoked in that context.
+ * Call epc_consumer_lookup_finish() from @callback to retrieve the value.
+ * Cancelling @cancellable also completes requests which still wait for
+ * the publisher.
+ *
+ * See also: epc_consumer_lookup()
+ *
+ * Since: 1.10
+ */
+void
+epc_consumer_lookup_async (EpcConsumer         *self,
+                           const gchar         *key,
+                           GCancellable        *cancellable,
+                           GAsyncReadyCallback  callback,
+                           gpointer             user_data)
+{
+  g_return_if_fail (EPC_IS_CONSUMER (self));
+  g_return_if_fail (NULL != key);
+
+  epc_consumer_queue_task (self,
+                           epc_consumer_create_task (self, key, cancellable,
+                                                     callback, user_data,
+                                                     epc_consumer_lookup_async));
+}
+
+/**
+ * epc_consumer_lookup_finish:
+ * @consumer: the consumer
+ * @result: the #GAsyncResult passed to your #GAsyncReadyCallback
+ * @length: location to store length in bytes of the contents, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes a request started with epc_consumer_lookup_async(). Errors are
+ * reported like for epc_consumer_lookup(), cancelled requests set @error
+ * to %G_IO_ERROR_CANCELLED.
+ *
+ * The returned buffer should be freed when no longer needed.
+ *
+ * Returns: A copy of the publisher's value for the the requested key,
+ * or %NULL when an error occurred.
+ *
+ * Since: 1.10
+ */
+gpointer
+epc_consumer_lookup_finish (EpcConsumer   *self,
+                            GAsyncResult  *result,
+                            gsize         *length,
+                            GError       **error)
+{
+  gpointer contents;
+  GBytes *bytes;
+  gsize size;
+
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epc_consumer_lookup_async), NULL);
+
+  bytes = g_task_propagate_pointer (G_TASK (result), error);
+
+  if (!bytes)
+    return NULL;
+
+  /* Steals the nul-terminated buffer, as this is the only reference. */
+  contents = g_bytes_unref_to_data (bytes, &size);
+
+  if (length)
+    *length = size;
+
+  return contents;
+}
+
+/**
+ * epc_consumer_list_async:
+ * @consumer: a #EpcConsumer
+ * @pattern: a glob-style pattern, or %NULL
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the request is satisfied
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously matches published keys against @pattern. See
+ * epc_consumer_list() for details, and epc_consumer_lookup_async()
+ * for notes on asynchronous operation. Call epc_consumer_list_finish()
+ * from @callback to retrieve the keys.
+ *
+ * Since: 1.10
+ */
+void
+epc_consumer_list_async (EpcConsumer         *self,
+                         const gchar         *pattern,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  g_return_if_fail (EPC_IS_CONSUMER (self));
+  g_return_if_fail (NULL == pattern || *pattern);
+
+  epc_consumer_queue_task (self,
+                           epc_consumer_create_task (self, pattern, cancellable,
+                                                     callback, user_data,
+                                                     epc_consumer_list_async));
+}
+
+/**
+ * epc_consumer_list_finish:
+ * @consumer: a #EpcConsumer
+ * @result: the #GAsyncResult passed to your #GAsyncReadyCallback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes a request started with epc_consumer_list_async(). The result
+ * and errors are reported like for epc_consumer_list().
+ *
+ * Returns: A newly allocated list of keys, or %NULL when an error occurred.
+ *
+ * Since: 1.10
+ */
+GList*
+epc_consumer_list_finish (EpcConsumer   *self,
+                          GAsyncResult  *result,
+                          GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+  g_return_val_if_fail (g_async_result_is_tagged (result, epc_consumer_list_async), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
 }
 
 GQuark
@@ -23,6 +23,7 @@
 
 #include <libepc/service-monitor.h>
 #include <libepc/service-type.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -45,6 +46,7 @@ G_BEGIN_DECLS
 typedef struct _EpcConsumer        EpcConsumer;
 typedef struct _EpcConsumerClass   EpcConsumerClass;
 typedef struct _EpcConsumerPrivate EpcConsumerPrivate;
+typedef struct _EpcListCursor      EpcListCursor;
 
 /**
  * EpcConsumer:
@@ -96,10 +98,13 @@ void                  epc_consumer_set_username          (EpcConsumer          *
                                                           const gchar          *username);
 void                  epc_consumer_set_password          (EpcConsumer          *consumer,
                                                           const gchar          *password);
+void                  epc_consumer_set_endpoint_cache    (EpcConsumer          *consumer,
+                                                          const gchar          *filename);
 
 EpcProtocol           epc_consumer_get_protocol          (EpcConsumer          *consumer);
 const gchar* epc_consumer_get_username          (EpcConsumer          *consumer);
 const gchar* epc_consumer_get_password          (EpcConsumer          *consumer);
+const gchar*          epc_consumer_get_endpoint_cache    (EpcConsumer          *consumer);
 
 gboolean              epc_consumer_resolve_publisher     (EpcConsumer          *consumer,
                                                           guint                 timeout);
@@ -109,9 +114,60 @@ gpointer              epc_consumer_lookup                (EpcConsumer          *
                                                           const gchar          *key,
                                                           gsize                *length,
                                                           GError              **error);
+GBytes*               epc_consumer_lookup_bytes          (EpcConsumer          *consumer,
+                                                          const gchar          *key,
+                                                          GError              **error);
+gpointer              epc_consumer_lookup_range          (EpcConsumer          *consumer,
+                                                          const gchar          *key,
+                                                          goffset               offset,
+                                                          gssize                length,
+                                                          gsize                *received,
+                                                          GError              **error);
+GInputStream*         epc_consumer_lookup_stream         (EpcConsumer          *consumer,
+                                                          const gchar          *key,
+                                                          GCancellable         *cancellable,
+                                                          GError              **error);
+gssize                epc_consumer_lookup_to_stream      (EpcConsumer          *consumer,
+                                                          const gchar          *key,
+                                                          GOutputStream        *output,
+                                                          GCancellable         *cancellable,
+                                                          GError              **error);
+gpointer              epc_consumer_revalidate            (EpcConsumer          *consumer,
+                                                          const gchar          *key,
+                                                          gchar               **etag,
+                                                          gsize                *length,
+                                                          GError              **error);
 GList*                epc_consumer_list                  (EpcConsumer          *consumer,
                                                           const gchar          *pattern,
                                                           GError              **error);
+EpcListCursor*        epc_consumer_list_cursor_new       (EpcConsumer          *consumer,
+                                                          const gchar          *pattern,
+                                                          guint                 page_size);
+GHashTable*           epc_consumer_lookup_many           (EpcConsumer          *consumer,
+                                                          const gchar          *pattern,
+                                                          GError              **error);
+
+void                  epc_consumer_lookup_async          (EpcConsumer          *consumer,
+                                                          const gchar          *key,
+                                                          GCancellable         *cancellable,
+                                                          GAsyncReadyCallback   callback,
+                                                          gpointer              user_data);
+gpointer              epc_consumer_lookup_finish         (EpcConsumer          *consumer,
+                                                          GAsyncResult         *result,
+                                                          gsize                *length,
+                                                          GError              **error);
+void                  epc_consumer_list_async            (EpcConsumer          *consumer,
+                                                          const gchar          *pattern,
+                                                          GCancellable         *cancellable,
+                                                          GAsyncReadyCallback   callback,
+                                                          gpointer              user_data);
+GList*                epc_consumer_list_finish           (EpcConsumer          *consumer,
+                                                          GAsyncResult         *result,
+                                                          GError              **error);
+
+const gchar*          epc_list_cursor_next               (EpcListCursor        *cursor,
+                                                          GError              **error);
+void                  epc_list_cursor_free               (EpcListCursor        *cursor);
 
 GQuark                epc_http_error_quark               (void) G_GNUC_CONST;
 
@@ -22,6 +22,7 @@
 #include "libepc/contents.h"
 #include "libepc/shell.h"
 
+#include <gio/gio.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -59,6 +60,32 @@
  * </example>
  */
 
+typedef struct _EpcPrefetch EpcPrefetch;
+
+/* Chunks of a streaming contents buffer read ahead of the consumer by a
+ * producer thread. The producer thread and the consumer synchronize by
+ * @mutex. Pending asynchronous reads wait in @readers. When the last
+ * reference is dropped while the producer thread still runs, the thread
+ * is marked @orphaned. Once it has exited the contents buffer is released
+ * in @context, the thread-default main context of the thread which
+ * started the producer thread.
+ */
+struct _EpcPrefetch
+{
+  GMutex              mutex;
+  GCond               cond;
+  GQueue              chunks;
+  GQueue              readers;
+  guint               depth;
+
+  GMainContext       *context;
+  GThread            *thread;
+  gboolean            finished;
+  gboolean            cancelled;
+  gboolean            exited;
+  gboolean            orphaned;
+};
+
 /**
  * EpcContents:
  *
@@ -75,9 +102,18 @@ struct _EpcContents
   gsize               buffer_size;
   GDestroyNotify      destroy_buffer;
 
+  gpointer            owner;
+  GDestroyNotify      destroy_owner;
+
+  gchar              *etag;
+  GBytes             *gzip_data;
+  GBytes             *deflate_data;
+
   EpcContentsReadFunc callback;
   gpointer            user_data;
   GDestroyNotify      destroy_data;
+
+  EpcPrefetch        *prefetch;
 };
 
 /**
@@ -150,6 +186,45 @@ epc_contents_new_dup (const gchar  *type,
   return epc_contents_new (type, cloned_data, length, g_free);
 }
 
+/**
+ * epc_contents_new_with_owner:
+ * @type: the MIME type of this contents, or %NULL
+ * @data: static contents for the buffer
+ * @length: the contents length in bytes, or -1 if @data is a null-terminated string.
+ * @owner: the object owning @data
+ * @destroy_owner: This function will be called to release @owner when it is no longer needed.
+ *
+ * Creates a new #EpcContents buffer for @data, which is owned by some other
+ * object like a #GMappedFile or #GBytes. The buffer neither copies nor frees
+ * @data, but keeps @owner alive until the buffer is released.
+ * Passing %NULL for @type is equivalent to passing "application/octet-stream".
+ *
+ * See also: epc_contents_new, epc_contents_new_dup
+ *
+ * Returns: The newly created #EpcContents buffer.
+ *
+ * Since: 1.10
+ */
+EpcContents*
+epc_contents_new_with_owner (const gchar    *type,
+                             gconstpointer   data,
+                             gssize          length,
+                             gpointer        owner,
+                             GDestroyNotify  destroy_owner)
+{
+  EpcContents *self;
+
+  self = epc_contents_new (type, (gpointer) data, length, NULL);
+
+  if (G_LIKELY (self))
+    {
+      self->owner = owner;
+      self->destroy_owner = destroy_owner;
+    }
+
+  return self;
+}
+
 /**
  * epc_contents_stream_new:
  * @type: the MIME type of this contents, or %NULL
@@ -190,6 +265,220 @@ epc_contents_stream_new (const gchar         *type,
   return self;
 }
 
+/* Reads the next chunk of @self into a newly allocated buffer,
+ * negotiating the buffer size like epc_contents_stream_read() does.
+ */
+/* Reads the next chunk into a buffer of its own, which is handed over
+ * to the caller as #GBytes without copying.
+ */
+static GBytes*
+epc_contents_stream_produce (EpcContents *self)
+{
+  gpointer buffer;
+  gsize length;
+
+  if (0 == self->buffer_size)
+    self->buffer_size = sysconf (_SC_PAGESIZE);
+
+  length = self->buffer_size;
+  buffer = g_malloc (length);
+
+  if (!self->callback (self, buffer, &length, self->user_data))
+    {
+      gssize page_size = sysconf (_SC_PAGESIZE);
+      gsize page_count = (length + page_size - 1) / page_size;
+
+      if (0 == length || length <= self->buffer_size)
+        {
+          g_free (buffer);
+          return NULL;
+        }
+
+      /* The old buffer has no valid contents, so don't copy it. */
+      g_free (buffer);
+
+      self->buffer_size = page_count * page_size;
+      buffer = g_malloc (self->buffer_size);
+      length = self->buffer_size;
+
+      if (!self->callback (self, buffer, &length, self->user_data))
+        {
+          g_free (buffer);
+          return NULL;
+        }
+    }
+
+  if (0 == length)
+    {
+      g_free (buffer);
+      return NULL;
+    }
+
+  return g_bytes_new_take (buffer, length);
+}
+
+/* Completes pending asynchronous reads for which a chunk is available.
+ * Must be called with the prefetch mutex held. Completion is dispatched
+ * to the main context of each reader, so no callback runs under the lock.
+ */
+static void
+epc_prefetch_complete_readers (EpcPrefetch *prefetch)
+{
+  while (!g_queue_is_empty (&prefetch->readers) &&
+         (prefetch->finished || !g_queue_is_empty (&prefetch->chunks)))
+    {
+      GTask *task = g_queue_pop_head (&prefetch->readers);
+
+      g_task_return_pointer (task, g_queue_pop_head (&prefetch->chunks),
+                             (GDestroyNotify) g_bytes_unref);
+      g_object_unref (task);
+    }
+}
+
+static void epc_contents_finalize (EpcContents *self);
+
+static gboolean
+epc_prefetch_finalize_cb (gpointer data)
+{
+  epc_contents_finalize (data);
+  return FALSE;
+}
+
+static gpointer
+epc_prefetch_thread (gpointer data)
+{
+  EpcContents *self = data;
+  EpcPrefetch *prefetch = self->prefetch;
+  GBytes *chunk = NULL;
+  gboolean orphaned;
+
+  do
+    {
+      gboolean cancelled;
+
+      g_mutex_lock (&prefetch->mutex);
+
+      while (!prefetch->cancelled &&
+             prefetch->chunks.length >= prefetch->depth)
+        g_cond_wait (&prefetch->cond, &prefetch->mutex);
+
+      cancelled = prefetch->cancelled;
+      g_mutex_unlock (&prefetch->mutex);
+
+      if (cancelled)
+        break;
+
+      chunk = epc_contents_stream_produce (self);
+
+      g_mutex_lock (&prefetch->mutex);
+
+      if (chunk)
+        g_queue_push_tail (&prefetch->chunks, chunk);
+      else
+        prefetch->finished = TRUE;
+
+      epc_prefetch_complete_readers (prefetch);
+
+      g_cond_broadcast (&prefetch->cond);
+      g_mutex_unlock (&prefetch->mutex);
+    }
+  while (chunk);
+
+  g_mutex_lock (&prefetch->mutex);
+  prefetch->exited = TRUE;
+  orphaned = prefetch->orphaned;
+  g_mutex_unlock (&prefetch->mutex);
+
+  /* The last reference was dropped while this thread was busy. Release
+   * the buffer in the owner's context, as the #GDestroyNotify passed to
+   * epc_contents_stream_new() might not be thread-safe. Use an idle source
+   * instead of g_main_context_invoke(), which would run the callback in
+   * this thread when nobody owns that context right now. */
+  if (orphaned)
+    {
+      GSource *source = g_idle_source_new ();
+
+      g_source_set_callback (source, epc_prefetch_finalize_cb, self, NULL);
+      g_source_attach (source, prefetch->context);
+      g_source_unref (source);
+    }
+
+  return NULL;
+}
+
+/* Stops the producer thread. Returns %TRUE when the thread still is
+ * busy and takes care of releasing the contents buffer. Waiting for
+ * the thread is not an option, as the last reference usually is
+ * dropped from the main loop, and the #EpcContentsReadFunc may block.
+ */
+static gboolean
+epc_prefetch_cancel (EpcPrefetch *prefetch)
+{
+  GThread *thread = prefetch->thread;
+  gboolean orphaned = FALSE;
+
+  g_mutex_lock (&prefetch->mutex);
+
+  prefetch->cancelled = TRUE;
+
+  if (!prefetch->exited)
+    orphaned = prefetch->orphaned = TRUE;
+
+  g_cond_broadcast (&prefetch->cond);
+  g_mutex_unlock (&prefetch->mutex);
+
+  /* The thread might release @prefetch already, don't touch it anymore. */
+  if (orphaned)
+    {
+      g_thread_unref (thread);
+      return TRUE;
+    }
+
+  /* The thread has left its loop, so this doesn't block. */
+  g_thread_join (thread);
+  prefetch->thread = NULL;
+
+  return FALSE;
+}
+
+static void
+epc_prefetch_free (EpcPrefetch *prefetch)
+{
+  g_queue_foreach (&prefetch->chunks, (GFunc) g_bytes_unref, NULL);
+  g_queue_clear (&prefetch->chunks);
+
+  if (prefetch->context)
+    g_main_context_unref (prefetch->context);
+
+  g_cond_clear (&prefetch->cond);
+  g_mutex_clear (&prefetch->mutex);
+  g_slice_free (EpcPrefetch, prefetch);
+}
+
+static void
+epc_contents_finalize (EpcContents *self)
+{
+  if (self->prefetch)
+    epc_prefetch_free (self->prefetch);
+
+  if (self->destroy_buffer)
+    self->destroy_buffer (self->buffer);
+  if (self->destroy_owner)
+    self->destroy_owner (self->owner);
+  if (self->destroy_data)
+    self->destroy_data (self->user_data);
+
+  if (self->gzip_data)
+    g_bytes_unref (self->gzip_data);
+  if (self->deflate_data)
+    g_bytes_unref (self->deflate_data);
+
+  g_free (self->etag);
+  g_free (self->type);
+
+  g_slice_free (EpcContents, self);
+}
+
 /**
  * epc_contents_ref:
  * @contents: a #EpcContents buffer
@@ -229,14 +518,11 @@ epc_contents_unref (EpcContents *self)
 
   if (g_atomic_int_dec_and_test (&self->ref_count))
     {
-      if (self->destroy_buffer)
-        self->destroy_buffer (self->buffer);
-      if (self->destroy_data)
-        self->destroy_data (self->user_data);
-
-      g_free (self->type);
+      if (self->prefetch && self->prefetch->thread &&
+          epc_prefetch_cancel (self->prefetch))
+        return;
 
-      g_slice_free (EpcContents, self);
+      epc_contents_finalize (self);
     }
 }
 
@@ -278,6 +564,222 @@ epc_contents_get_mime_type (EpcContents *self)
   return "application/octet-stream";
 }
 
+/**
+ * epc_contents_get_etag:
+ * @contents: a #EpcContents buffer
+ *
+ * Queries the entity tag identifying the current value of the buffer. The
+ * #EpcPublisher uses this tag to answer conditional requests, so that
+ * consumers don't have to download unchanged values again.
+ *
+ * Unless a tag was assigned with epc_contents_set_etag(), the tag of a
+ * static buffer is computed from a SHA-1 checksum of its data on first use.
+ * Streaming buffers have no entity tag unless one was assigned explicitly.
+ *
+ * Returns: The entity tag of the buffer without surrounding quotes,
+ * or %NULL. This should not be freed or modified.
+ *
+ * Since: 1.10
+ */
+const gchar*
+epc_contents_get_etag (EpcContents *self)
+{
+  gchar *etag;
+
+  g_return_val_if_fail (NULL != self, NULL);
+
+  etag = g_atomic_pointer_get (&self->etag);
+
+  if (!etag && !epc_contents_is_stream (self))
+    {
+      etag = g_compute_checksum_for_data (G_CHECKSUM_SHA1,
+                                          self->buffer,
+                                          self->buffer_size);
+
+      /* Buffers are shared between threads, so another thread
+       * might have won the race for computing the checksum. */
+      if (!g_atomic_pointer_compare_and_exchange (&self->etag, NULL, etag))
+        {
+          g_free (etag);
+          etag = g_atomic_pointer_get (&self->etag);
+        }
+    }
+
+  return etag;
+}
+
+/**
+ * epc_contents_peek_etag:
+ * @contents: a #EpcContents buffer
+ *
+ * Queries the entity tag of the buffer like epc_contents_get_etag() does,
+ * but without computing the checksum of its data when no tag is known yet.
+ *
+ * Returns: The entity tag of the buffer without surrounding quotes,
+ * or %NULL. This should not be freed or modified.
+ *
+ * Since: 1.10
+ */
+const gchar*
+epc_contents_peek_etag (EpcContents *self)
+{
+  g_return_val_if_fail (NULL != self, NULL);
+  return g_atomic_pointer_get (&self->etag);
+}
+
+/**
+ * epc_contents_set_etag:
+ * @contents: a #EpcContents buffer
+ * @etag: the new entity tag, or %NULL
+ *
+ * Assigns an entity tag to the buffer, for instance a version counter
+ * maintained by the application. This is cheaper than the checksum computed
+ * by epc_contents_get_etag() for large buffers, and is the only way to
+ * provide entity tags for streaming buffers. The tag must be unique among
+ * all values published for the same key, and must not contain double quotes.
+ *
+ * The #EpcPublisher computes checksums of buffers returned by an
+ * #EpcContentsHandler only for requests carrying validators, so
+ * clients only learn the tag of such buffers when it was assigned
+ * with this function.
+ *
+ * Call this function before returning the buffer from your
+ * #EpcContentsHandler, as the tag is not protected against concurrent
+ * modification.
+ *
+ * Since: 1.10
+ */
+void
+epc_contents_set_etag (EpcContents *self,
+                       const gchar *etag)
+{
+  gchar *old_etag;
+
+  g_return_if_fail (NULL != self);
+  g_return_if_fail (NULL == etag || NULL == strchr (etag, '"'));
+
+  old_etag = self->etag;
+  self->etag = g_strdup (etag);
+  g_free (old_etag);
+}
+
+static GBytes*
+epc_contents_compress (GZlibCompressorFormat  format,
+                       const guint8          *data,
+                       gsize                  length)
+{
+  GConverterResult result;
+  GConverter *compressor;
+  GError *error = NULL;
+  GByteArray *output;
+  gsize used = 0;
+
+  compressor = G_CONVERTER (g_zlib_compressor_new (format, -1));
+  output = g_byte_array_new ();
+
+  do
+    {
+      gsize bytes_read, bytes_written;
+
+      g_byte_array_set_size (output, used + 4096 + length / 4);
+
+      result = g_converter_convert (compressor, data, length,
+                                    output->data + used, output->len - used,
+                                    G_CONVERTER_INPUT_AT_END,
+                                    &bytes_read, &bytes_written, &error);
+
+      data += bytes_read;
+      length -= bytes_read;
+      used += bytes_written;
+    }
+  while (G_CONVERTER_CONVERTED == result);
+
+  g_object_unref (compressor);
+
+  if (G_CONVERTER_ERROR == result)
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_byte_array_unref (output);
+      g_error_free (error);
+
+      return NULL;
+    }
+
+  g_byte_array_set_size (output, used);
+
+  return g_byte_array_free_to_bytes (output);
+}
+
+/**
+ * epc_contents_get_encoded_data:
+ * @contents: a #EpcContents buffer
+ * @encoding: a HTTP content coding, like "gzip" or "deflate"
+ * @length: a location for storing the length of the encoded contents
+ *
+ * Retrieves the contents of a static contents buffer compressed according to
+ * @encoding. The compressed data is computed on first use and kept with the
+ * buffer, so that the #EpcPublisher doesn't compress values published with
+ * epc_publisher_add() again for each request.
+ *
+ * The whole buffer is compressed synchronously by the calling thread, and
+ * the result is kept as long as @contents lives. Avoid calling this for
+ * large or short-lived buffers. The #EpcPublisher only uses it for values
+ * published with epc_publisher_add() and for its own listings.
+ *
+ * Streaming buffers and unsupported encodings return %NULL.
+ *
+ * Returns: Returns the encoded contents, or %NULL. This should not be freed or modified.
+ *
+ * Since: 1.10
+ */
+gconstpointer
+epc_contents_get_encoded_data (EpcContents *self,
+                               const gchar *encoding,
+                               gsize       *length)
+{
+  GZlibCompressorFormat format;
+  GBytes **location;
+  GBytes *encoded;
+
+  g_return_val_if_fail (NULL != self, NULL);
+  g_return_val_if_fail (NULL != encoding, NULL);
+
+  if (epc_contents_is_stream (self))
+    return NULL;
+
+  if (g_str_equal (encoding, "gzip"))
+    {
+      format = G_ZLIB_COMPRESSOR_FORMAT_GZIP;
+      location = &self->gzip_data;
+    }
+  else if (g_str_equal (encoding, "deflate"))
+    {
+      format = G_ZLIB_COMPRESSOR_FORMAT_ZLIB;
+      location = &self->deflate_data;
+    }
+  else
+    return NULL;
+
+  encoded = g_atomic_pointer_get (location);
+
+  if (!encoded)
+    {
+      encoded = epc_contents_compress (format, self->buffer, self->buffer_size);
+
+      if (!encoded)
+        return NULL;
+
+      /* Same race as in epc_contents_get_etag(). */
+      if (!g_atomic_pointer_compare_and_exchange (location, NULL, encoded))
+        {
+          g_bytes_unref (encoded);
+          encoded = g_atomic_pointer_get (location);
+        }
+    }
+
+  return g_bytes_get_data (encoded, length);
+}
+
 /**
  * epc_contents_get_data:
  * @contents: a #EpcContents buffer
@@ -357,3 +859,204 @@ epc_contents_stream_read (EpcContents *self,
 
   return data;
 }
+
+/**
+ * epc_contents_stream_set_prefetch:
+ * @contents: a #EpcContents buffer
+ * @depth: the number of chunks to read ahead, or 0
+ *
+ * Makes epc_contents_stream_read_bytes() read up to @depth chunks ahead of
+ * its caller. The #EpcContentsReadFunc of @contents then is called from a
+ * separate producer thread, so that a slow producer fills the next chunks
+ * while previous chunks are delivered. Passing 0 for @depth disables
+ * prefetching.
+ *
+ * The producer thread is started by the first read. When the last
+ * reference on @contents is dropped while the producer thread still is
+ * busy, the #GDestroyNotify passed to epc_contents_stream_new() is called
+ * from the thread-default main context of the thread which did that first
+ * read, once the #EpcContentsReadFunc has returned.
+ *
+ * This must be called before reading from @contents.
+ *
+ * See also: epc_contents_stream_read_bytes()
+ *
+ * Since: 1.10
+ */
+void
+epc_contents_stream_set_prefetch (EpcContents *self,
+                                  guint        depth)
+{
+  g_return_if_fail (epc_contents_is_stream (self));
+  g_return_if_fail (NULL == self->prefetch || NULL == self->prefetch->thread);
+
+  if (self->prefetch)
+    {
+      epc_prefetch_free (self->prefetch);
+      self->prefetch = NULL;
+    }
+
+  if (depth > 0)
+    {
+      self->prefetch = g_slice_new0 (EpcPrefetch);
+      self->prefetch->depth = depth;
+
+      g_mutex_init (&self->prefetch->mutex);
+      g_cond_init (&self->prefetch->cond);
+      g_queue_init (&self->prefetch->chunks);
+      g_queue_init (&self->prefetch->readers);
+    }
+}
+
+/* Starts the producer thread on first use. Must be called with the
+ * prefetch mutex held.
+ */
+static void
+epc_prefetch_start (EpcContents *self)
+{
+  EpcPrefetch *prefetch = self->prefetch;
+
+  if (prefetch->thread || prefetch->finished)
+    return;
+
+  prefetch->context = g_main_context_ref_thread_default ();
+  prefetch->thread = g_thread_new ("epc-prefetch", epc_prefetch_thread, self);
+}
+
+/**
+ * epc_contents_stream_read_bytes:
+ * @contents: a #EpcContents buffer
+ *
+ * Retrieves the next chunk of data for a streaming contents buffer created
+ * with epc_contents_stream_new(). Other than epc_contents_stream_read()
+ * each chunk is stored in a buffer of its own, which the caller owns and
+ * can pass on without copying. %NULL is returned, when the buffer has
+ * reached its end.
+ *
+ * Don't mix calls of this function and epc_contents_stream_read() for the
+ * same @contents.
+ *
+ * With prefetching this function blocks until the producer thread
+ * has delivered the next chunk. Use epc_contents_stream_read_bytes_async()
+ * to avoid blocking the main loop.
+ *
+ * See also: epc_contents_stream_set_prefetch()
+ *
+ * Returns: The next chunk of data, or %NULL. Free with g_bytes_unref().
+ *
+ * Since: 1.10
+ */
+GBytes*
+epc_contents_stream_read_bytes (EpcContents *self)
+{
+  EpcPrefetch *prefetch;
+  GBytes *chunk;
+
+  g_return_val_if_fail (epc_contents_is_stream (self), NULL);
+
+  prefetch = self->prefetch;
+
+  if (!prefetch)
+    return epc_contents_stream_produce (self);
+
+  g_mutex_lock (&prefetch->mutex);
+  epc_prefetch_start (self);
+
+  while (!prefetch->finished && g_queue_is_empty (&prefetch->chunks))
+    g_cond_wait (&prefetch->cond, &prefetch->mutex);
+
+  chunk = g_queue_pop_head (&prefetch->chunks);
+
+  if (chunk)
+    g_cond_broadcast (&prefetch->cond);
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: %u chunks prefetched", G_STRLOC, prefetch->chunks.length);
+
+  g_mutex_unlock (&prefetch->mutex);
+
+  return chunk;
+}
+
+/**
+ * epc_contents_stream_read_bytes_async:
+ * @contents: a #EpcContents buffer
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the chunk is available
+ * @user_data: the data to pass to @callback
+ *
+ * Asynchronously retrieves the next chunk of data for a streaming contents
+ * buffer, like epc_contents_stream_read_bytes() does. With prefetching
+ * the request waits for the producer thread without blocking the caller.
+ * Otherwise the chunk is read immediately.
+ *
+ * The @callback is invoked in the thread-default main context of the
+ * thread calling this function. Call epc_contents_stream_read_bytes_finish()
+ * from @callback to retrieve the chunk. Cancelling @cancellable doesn't
+ * interrupt the #EpcContentsReadFunc, the request fails with
+ * %G_IO_ERROR_CANCELLED when the pending chunk has been produced.
+ *
+ * Since: 1.10
+ */
+void
+epc_contents_stream_read_bytes_async (EpcContents         *self,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+  EpcPrefetch *prefetch;
+  GTask *task;
+
+  g_return_if_fail (epc_contents_is_stream (self));
+
+  /* The task keeps @contents alive while the request is pending. */
+  task = g_task_new (NULL, cancellable, callback, user_data);
+  g_task_set_source_tag (task, epc_contents_stream_read_bytes_async);
+  g_task_set_task_data (task, epc_contents_ref (self),
+                        (GDestroyNotify) epc_contents_unref);
+
+  prefetch = self->prefetch;
+
+  if (!prefetch)
+    {
+      g_task_return_pointer (task, epc_contents_stream_read_bytes (self),
+                             (GDestroyNotify) g_bytes_unref);
+      g_object_unref (task);
+      return;
+    }
+
+  g_mutex_lock (&prefetch->mutex);
+  epc_prefetch_start (self);
+
+  g_queue_push_tail (&prefetch->readers, task);
+  epc_prefetch_complete_readers (prefetch);
+  g_cond_broadcast (&prefetch->cond);
+
+  g_mutex_unlock (&prefetch->mutex);
+}
+
+/**
+ * epc_contents_stream_read_bytes_finish:
+ * @contents: a #EpcContents buffer
+ * @result: the #GAsyncResult passed to your #GAsyncReadyCallback
+ * @error: return location for a #GError, or %NULL
+ *
+ * Finishes a request started with epc_contents_stream_read_bytes_async().
+ * %NULL is returned without setting @error, when the buffer has reached
+ * its end.
+ *
+ * Returns: The next chunk of data, or %NULL. Free with g_bytes_unref().
+ *
+ * Since: 1.10
+ */
+GBytes*
+epc_contents_stream_read_bytes_finish (EpcContents   *self,
+                                       GAsyncResult  *result,
+                                       GError       **error)
+{
+  g_return_val_if_fail (epc_contents_is_stream (self), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+  g_return_val_if_fail (g_task_get_task_data (G_TASK (result)) == self, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -21,7 +21,7 @@
 #ifndef __EPC_CONTENTS_H__
 #define __EPC_CONTENTS_H__
 
-#include <glib.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -44,6 +44,9 @@ typedef struct _EpcContents EpcContents;
  * The library might pass %NULL for @buffer on the first call to start buffer
  * size negotation.
  *
+ * This callback is called from a separate thread, when prefetching was
+ * requested by epc_contents_stream_set_prefetch().
+ *
  * See also: #epc_contents_stream_new, #epc_contents_stream_read
  *
  * Returns: Returns %TRUE when the next chunk could be read, and %FALSE on error.
@@ -60,6 +63,11 @@ EpcContents*          epc_contents_new           (const gchar         *type,
 EpcContents*          epc_contents_new_dup       (const gchar         *type,
                                                   gconstpointer        data,
                                                   gssize               length);
+EpcContents*          epc_contents_new_with_owner(const gchar         *type,
+                                                  gconstpointer        data,
+                                                  gssize               length,
+                                                  gpointer             owner,
+                                                  GDestroyNotify       destroy_owner);
 EpcContents*          epc_contents_stream_new    (const gchar         *type,
                                                   EpcContentsReadFunc  callback,
                                                   gpointer             user_data,
@@ -71,10 +79,28 @@ void                  epc_contents_unref         (EpcContents         *contents)
 gboolean              epc_contents_is_stream     (EpcContents         *contents);
 const gchar* epc_contents_get_mime_type (EpcContents         *contents);
 
+const gchar*          epc_contents_get_etag      (EpcContents         *contents);
+const gchar*          epc_contents_peek_etag     (EpcContents         *contents);
+void                  epc_contents_set_etag      (EpcContents         *contents,
+                                                  const gchar         *etag);
+
 gconstpointer         epc_contents_get_data      (EpcContents         *contents,
                                                   gsize               *length);
+gconstpointer         epc_contents_get_encoded_data(EpcContents       *contents,
+                                                  const gchar         *encoding,
+                                                  gsize               *length);
 gconstpointer         epc_contents_stream_read   (EpcContents         *contents,
                                                   gsize               *length);
+GBytes*               epc_contents_stream_read_bytes(EpcContents       *contents);
+void                  epc_contents_stream_read_bytes_async(EpcContents *contents,
+                                                  GCancellable        *cancellable,
+                                                  GAsyncReadyCallback  callback,
+                                                  gpointer             user_data);
+GBytes*               epc_contents_stream_read_bytes_finish(EpcContents *contents,
+                                                  GAsyncResult        *result,
+                                                  GError             **error);
+void                  epc_contents_stream_set_prefetch(EpcContents     *contents,
+                                                  guint                depth);
 
 G_END_DECLS
 
@@ -30,8 +30,12 @@
 #include "libepc/tls.h"
 
 #include <glib/gi18n-lib.h>
+#include <glib/gstdio.h>
 #include <libsoup/soup.h>
+#include <errno.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 #if GLIB_CHECK_VERSION(2,15,1)
 #include <gio/gio.h>
@@ -125,8 +129,40 @@
  * as if the value has been removed.
  */
 
-typedef struct _EpcListContext EpcListContext;
-typedef struct _EpcResource    EpcResource;
+#define EPC_FILE_SNIFF_LENGTH 4096
+#define EPC_FILE_MAP_MIN_LENGTH 65536
+#define EPC_COMPRESSION_MIN_LENGTH 256
+#define EPC_COMPRESSION_MAX_LENGTH 1048576
+#define EPC_LISTING_MIME_TYPE "application/x-epc-list"
+#define EPC_LISTING_DEFAULT_LIMIT 1000
+#define EPC_LISTING_MAX_LIMIT 10000
+
+typedef struct _EpcAuthBinding    EpcAuthBinding;
+typedef struct _EpcFileResource   EpcFileResource;
+typedef struct _EpcHandlerCall    EpcHandlerCall;
+typedef struct _EpcListener       EpcListener;
+typedef struct _EpcListenerUpdate EpcListenerUpdate;
+typedef struct _EpcListingBuilder EpcListingBuilder;
+typedef struct _EpcResource       EpcResource;
+typedef struct _EpcServerCall     EpcServerCall;
+typedef struct _EpcStreamWriter   EpcStreamWriter;
+
+typedef enum
+{
+  EPC_LISTING_FORMAT_MARKUP,
+  EPC_LISTING_FORMAT_BINARY,
+  EPC_LISTING_FORMAT_LAST
+}
+EpcListingFormat;
+
+typedef enum
+{
+  EPC_SERVER_CALL_PENDING,
+  EPC_SERVER_CALL_RUNNING,
+  EPC_SERVER_CALL_DONE,
+  EPC_SERVER_CALL_CANCELLED
+}
+EpcServerCallState;
 
 enum
 {
@@ -142,6 +178,8 @@ enum
   PROP_CONTENTS_PATH,
   PROP_CERTIFICATE_FILE,
   PROP_PRIVATE_KEY_FILE,
+  PROP_HANDLER_THREADS,
+  PROP_LISTENER_THREADS
 };
 
 /**
@@ -170,23 +208,152 @@ struct _EpcAuthContext
   /*< public >*/
 };
 
-struct _EpcListContext
+/**
+ * EpcContentsRequest:
+ *
+ * This data structure describes a pending request for contents published
+ * with epc_publisher_add_async_handler(). The request is finished by
+ * calling epc_contents_request_complete().
+ */
+struct _EpcContentsRequest
+{
+  /*< private >*/
+  EpcPublisher   *publisher;
+  SoupServer     *server;
+  SoupMessage    *message;
+  GSocket        *socket;
+  GMainContext   *context;
+  EpcResource    *resource;
+  gchar          *key;
+
+  EpcListener    *listener;
+  EpcContents    *contents;
+  gulong          finished_id;
+  gboolean        finished;
+  gboolean        completed;
+  gboolean        abandoned;
+
+  /*< public >*/
+};
+
+/* An additional server accepting connections in its own thread. All
+ * listeners share the port of the publisher's primary server through
+ * SO_REUSEPORT, and the resources of the publisher. The handlers of
+ * @server are only touched from the listener's thread. The @requests
+ * list holds the paused requests of the listener, and is protected by
+ * epc_publisher_lock.
+ */
+struct _EpcListener
+{
+  EpcPublisher      *publisher;
+  GThread           *thread;
+  GMainContext      *context;
+  GMainLoop         *loop;
+  SoupServer        *server;
+
+  SoupAuthDomain    *server_auth;
+  gchar             *contents_path;
+
+  GList             *requests;
+  gboolean           detached;
+};
+
+struct _EpcListenerUpdate
+{
+  EpcListener       *listener;
+  SoupAuthDomain    *server_auth;
+  gchar             *contents_path;
+};
+
+/* A handler call passed from a listener thread to the main context of
+ * the primary server, for handlers which are not thread-safe. The state
+ * is protected by epc_server_call_mutex.
+ */
+struct _EpcServerCall
+{
+  volatile gint      ref_count;
+  EpcServerCallState state;
+  GSourceFunc        func;
+  gpointer           data;
+};
+
+/* Arguments and results of a handler passed to epc_publisher_call_in_server_context(). */
+struct _EpcHandlerCall
+{
+  EpcPublisher      *publisher;
+  EpcResource       *resource;
+  const gchar       *key;
+  EpcAuthContext    *auth_context;
+  const gchar       *username;
+
+  EpcContents       *contents;
+  gboolean           authorized;
+  EpcAuthBinding    *auth;
+};
+
+/* Feeds the chunks of a streaming contents buffer into a response.
+ * The message is paused while a chunk is read, so that slow producers
+ * don't block the server.
+ */
+struct _EpcStreamWriter
+{
+  SoupServer        *server;
+  EpcContents       *contents;
+  GCancellable      *cancellable;
+};
+
+struct _EpcListingBuilder
+{
+  GHashTable       *resources;
+  EpcListingFormat  format;
+  GString          *contents;
+};
+
+struct _EpcFileResource
+{
+  gchar             *filename;
+  gchar             *mime_type;
+  gchar             *guessed_type;
+
+  GMutex             mutex;
+  EpcContents       *contents;
+
+  dev_t              device;
+  ino_t              inode;
+  time_t             mtime;
+  glong              mtime_nsec;
+  off_t              size;
+};
+
+/* An authentication handler installed for a resource. Handlers run without
+ * holding epc_publisher_lock, so callers take a reference on the binding
+ * while holding the lock. Replacing the handler then releases its data
+ * only after the last running call has finished.
+ */
+struct _EpcAuthBinding
 {
-  GPatternSpec *pattern;
-  GList *matches;
+  volatile gint      ref_count;
+
+  EpcAuthHandler     handler;
+  gpointer           user_data;
+  GDestroyNotify     destroy_data;
 };
 
 struct _EpcResource
 {
+  volatile gint      ref_count;
+
   EpcContentsHandler handler;
+  EpcAsyncContentsHandler async_handler;
+  volatile gint      flags;
   gpointer           user_data;
   GDestroyNotify     destroy_data;
 
-  EpcAuthHandler     auth_handler;
-  gpointer           auth_user_data;
-  GDestroyNotify     auth_destroy_data;
+  EpcAuthBinding    *auth;
 
   EpcDispatcher     *dispatcher;
+
+  gchar             *markup;
 };
 
 /**
@@ -199,10 +366,16 @@ struct _EpcPublisherPrivate
   EpcDispatcher         *dispatcher;
 
   GHashTable            *resources;
+  GSequence             *resource_index;
+  guint                  resources_generation;
   EpcResource           *default_resource;
   gchar                 *default_bookmark;
 
+  EpcContents           *listings[EPC_LISTING_FORMAT_LAST];
+  guint                  listing_generations[EPC_LISTING_FORMAT_LAST];
+
   gboolean               server_started;
+  GMainContext          *server_context;
   GMainLoop             *server_loop;
   SoupServer            *server;
 
@@ -221,12 +394,56 @@ struct _EpcPublisherPrivate
   gchar                 *contents_path;
   gchar                 *certificate_file;
   gchar                 *private_key_file;
+
+  GThreadPool           *handler_pool;
+  gint                   handler_threads;
+
+  GSList                *listeners;
+  gint                   listener_threads;
+  gboolean               listeners_stopping;
 };
 
 static GRecMutex epc_publisher_lock;
 
+static GMutex epc_server_call_mutex;
+static GCond epc_server_call_cond;
+
 G_DEFINE_TYPE (EpcPublisher, epc_publisher, G_TYPE_OBJECT);
 
+static EpcAuthBinding*
+epc_auth_binding_new (EpcAuthHandler  handler,
+                      gpointer        user_data,
+                      GDestroyNotify  destroy_data)
+{
+  EpcAuthBinding *self = g_slice_new0 (EpcAuthBinding);
+
+  self->ref_count = 1;
+  self->handler = handler;
+  self->user_data = user_data;
+  self->destroy_data = destroy_data;
+
+  return self;
+}
+
+static EpcAuthBinding*
+epc_auth_binding_ref (EpcAuthBinding *self)
+{
+  g_atomic_int_inc (&self->ref_count);
+  return self;
+}
+
+static void
+epc_auth_binding_unref (EpcAuthBinding *self)
+{
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  if (self->destroy_data)
+    self->destroy_data (self->user_data);
+
+  g_slice_free (EpcAuthBinding, self);
+}
+
 static EpcResource*
 epc_resource_new (EpcContentsHandler handler,
                   gpointer           user_data,
@@ -234,6 +451,7 @@ epc_resource_new (EpcContentsHandler handler,
 {
   EpcResource *self = g_slice_new0 (EpcResource);
 
+  self->ref_count = 1;
   self->handler = handler;
   self->user_data = user_data;
   self->destroy_data = destroy_data;
@@ -241,21 +459,34 @@ epc_resource_new (EpcContentsHandler handler,
   return self;
 }
 
+static EpcResource*
+epc_resource_ref (EpcResource *self)
+{
+  g_atomic_int_inc (&self->ref_count);
+  return self;
+}
+
 static void
-epc_resource_free (gpointer data)
+epc_resource_unref (gpointer data)
 {
   EpcResource *self = data;
 
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
   if (self->dispatcher)
     g_object_unref (self->dispatcher);
   if (self->destroy_data)
     self->destroy_data (self->user_data);
-  if (self->auth_destroy_data)
-    self->auth_destroy_data (self->auth_user_data);
+  if (self->auth)
+    epc_auth_binding_unref (self->auth);
+
+  g_free (self->markup);
 
   g_slice_free (EpcResource, self);
 }
 
+/* Must be called with epc_publisher_lock held. */
 static void
 epc_resource_set_auth_handler (EpcResource    *self,
                                EpcAuthHandler  handler,
@@ -263,12 +494,41 @@ epc_resource_set_auth_handler (EpcResource    *self,
                                GDestroyNotify  destroy_data)
 
 {
-  if (self->auth_destroy_data)
-    self->auth_destroy_data (self->auth_user_data);
+  EpcAuthBinding *auth = self->auth;
+
+  g_atomic_pointer_set (&self->auth, epc_auth_binding_new (handler, user_data, destroy_data));
+
+  /* Calls still running keep their own reference. */
+  if (auth)
+    epc_auth_binding_unref (auth);
+}
+
+/* Returns a new reference to the authentication handler of @self, or %NULL. */
+static EpcAuthBinding*
+epc_resource_ref_auth (EpcResource *self)
+{
+  EpcAuthBinding *auth = NULL;
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  if (self->auth)
+    auth = epc_auth_binding_ref (self->auth);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  return auth;
+}
+
+static gboolean
+epc_resource_has_auth (EpcResource *self)
+{
+  return NULL != g_atomic_pointer_get (&self->auth);
+}
 
-  self->auth_handler = handler;
-  self->auth_user_data = user_data;
-  self->auth_destroy_data = destroy_data;
+static EpcHandlerFlags
+epc_resource_get_flags (EpcResource *self)
+{
+  return g_atomic_int_get (&self->flags);
 }
 
 static void
@@ -297,31 +557,182 @@ epc_publisher_handle_static (EpcPublisher *publisher G_GNUC_UNUSED,
                              const gchar  *key G_GNUC_UNUSED,
                              gpointer      user_data)
 {
+  /* Published values outlive the request, so their checksum pays off. */
+  epc_contents_get_etag (user_data);
   return epc_contents_ref (user_data);
 }
 
+static EpcFileResource*
+epc_file_resource_new (const gchar *filename,
+                       const gchar *mime_type)
+{
+  EpcFileResource *self = g_slice_new0 (EpcFileResource);
+
+  self->filename = g_strdup (filename);
+  self->mime_type = g_strdup (mime_type);
+  g_mutex_init (&self->mutex);
+
+  return self;
+}
+
+static void
+epc_file_resource_free (gpointer data)
+{
+  EpcFileResource *self = data;
+
+  if (self->contents)
+    epc_contents_unref (self->contents);
+
+  g_mutex_clear (&self->mutex);
+  g_free (self->guessed_type);
+  g_free (self->mime_type);
+  g_free (self->filename);
+
+  g_slice_free (EpcFileResource, self);
+}
+
+static glong
+epc_stat_get_mtime_nsec (const GStatBuf *info)
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  return info->st_mtim.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+/* Small files are read into memory: Mapping them saves little, and reading
+ * keeps them safe from being truncated in place while being served.
+ */
 static EpcContents*
-epc_publisher_handle_file (EpcPublisher *publisher G_GNUC_UNUSED,
-                           const gchar  *key G_GNUC_UNUSED,
-                           gpointer      user_data)
+epc_file_resource_map (EpcFileResource *self)
 {
-  const gchar *filename = user_data;
+  GMappedFile *mapping = NULL;
   EpcContents *contents = NULL;
-  gchar *data = NULL;
+  GError *error = NULL;
+  const gchar *type;
   gsize length = 0;
+  gchar *data = NULL;
+  gchar *etag;
 
-  if (g_file_get_contents (filename, &data, &length, NULL))
+  if (self->size < EPC_FILE_MAP_MIN_LENGTH)
+    g_file_get_contents (self->filename, &data, &length, &error);
+  else if (NULL != (mapping = g_mapped_file_new (self->filename, FALSE, &error)))
     {
-      gchar *type = NULL;
+      data = g_mapped_file_get_contents (mapping);
+      length = g_mapped_file_get_length (mapping);
+    }
+
+  if (error)
+    {
+      if (EPC_DEBUG_LEVEL (1))
+        g_debug ("%s: %s", G_STRLOC, error->message);
+
+      g_error_free (error);
+      return NULL;
+    }
+
+  type = self->mime_type;
 
 #if GLIB_CHECK_VERSION(2,15,1)
-      type = g_content_type_guess (filename, (gpointer) data, length, NULL);
+  /* Sniffing only needs the first few bytes, and its result is kept
+   * until the file gets replaced or modified. */
+  if (!type && !self->guessed_type)
+    self->guessed_type = g_content_type_guess (self->filename, (gpointer) data,
+                                               MIN (length, EPC_FILE_SNIFF_LENGTH),
+                                               NULL);
+
+  if (!type)
+    type = self->guessed_type;
 #endif
-      contents = epc_contents_new (type, data, length, g_free);
 
-      g_free (type);
+  /* Empty files cannot be mapped, and have no contents pointer. */
+  if (!mapping)
+    contents = epc_contents_new (type, data, length, g_free);
+  else if (data)
+    contents = epc_contents_new_with_owner (type, data, length, mapping,
+                                            (GDestroyNotify) g_mapped_file_unref);
+  else
+    {
+      contents = epc_contents_new_dup (type, "", 0);
+      g_mapped_file_unref (mapping);
+    }
+
+  /* Checksumming large files would be expensive, and file identity,
+   * modification time and size are sufficient for detecting changes. */
+  etag = g_strdup_printf ("%" G_GINT64_MODIFIER "x-%" G_GINT64_MODIFIER "x.%"
+                          G_GINT64_MODIFIER "x-%" G_GINT64_MODIFIER "x",
+                          (guint64) self->inode, (guint64) self->mtime,
+                          (guint64) self->mtime_nsec, (guint64) self->size);
+  epc_contents_set_etag (contents, etag);
+  g_free (etag);
+
+  return contents;
+}
+
+static EpcContents*
+epc_publisher_handle_file (EpcPublisher *publisher G_GNUC_UNUSED,
+                           const gchar  *key G_GNUC_UNUSED,
+                           gpointer      user_data)
+{
+  EpcFileResource *self = user_data;
+  EpcContents *contents = NULL;
+  glong mtime_nsec;
+  GStatBuf info;
+
+  if (g_stat (self->filename, &info))
+    {
+      if (EPC_DEBUG_LEVEL (1))
+        g_debug ("%s: %s: %s", G_STRLOC, self->filename, g_strerror (errno));
+
+      return NULL;
+    }
+
+  /* Files modified twice within one second must not look unchanged. */
+  mtime_nsec = epc_stat_get_mtime_nsec (&info);
+
+  g_mutex_lock (&self->mutex);
+
+  /* Reuse the current mapping as long as the file looks unchanged, so that
+   * concurrent clients share the same pages instead of reading the file into
+   * private heap buffers. Modified files get mapped again, so clients still
+   * see the current contents at the time of access. */
+  if (self->device != info.st_dev ||
+      self->inode != info.st_ino ||
+      self->mtime != info.st_mtime ||
+      self->mtime_nsec != mtime_nsec)
+    {
+      g_free (self->guessed_type);
+      self->guessed_type = NULL;
+    }
+
+  if (self->contents &&
+      (self->device != info.st_dev ||
+       self->inode != info.st_ino ||
+       self->mtime != info.st_mtime ||
+       self->mtime_nsec != mtime_nsec ||
+       self->size != info.st_size))
+    {
+      epc_contents_unref (self->contents);
+      self->contents = NULL;
+    }
+
+  if (!self->contents)
+    {
+      self->device = info.st_dev;
+      self->inode = info.st_ino;
+      self->mtime = info.st_mtime;
+      self->mtime_nsec = mtime_nsec;
+      self->size = info.st_size;
+
+      self->contents = epc_file_resource_map (self);
     }
 
+  if (self->contents)
+    contents = epc_contents_ref (self->contents);
+
+  g_mutex_unlock (&self->mutex);
+
   return contents;
 }
 
@@ -341,31 +752,158 @@ epc_publisher_get_key (const gchar *path)
   return key;
 }
 
+/* Compresses a chunk of streaming contents on the fly. Each chunk is
+ * flushed, so that clients receive data as soon as the stream provides it.
+ */
 static void
-epc_publisher_chunk_cb (SoupMessage *message,
-                        gpointer     data)
+epc_publisher_append_encoded (SoupMessage     *message,
+                              GConverter      *converter,
+                              const guint8    *data,
+                              gsize            length,
+                              GConverterFlags  flags)
+{
+  GConverterResult result;
+  GError *error = NULL;
+  guint8 buffer[8192];
+
+  do
+    {
+      gsize bytes_read, bytes_written;
+
+      result = g_converter_convert (converter, data, length,
+                                    buffer, sizeof buffer, flags,
+                                    &bytes_read, &bytes_written, &error);
+
+      if (G_CONVERTER_ERROR == result)
+        {
+          g_warning ("%s: %s", G_STRLOC, error->message);
+          g_clear_error (&error);
+          break;
+        }
+
+      if (bytes_written > 0)
+        soup_message_body_append (message->response_body,
+                                  SOUP_MEMORY_COPY, buffer, bytes_written);
+
+      data += bytes_read;
+      length -= bytes_read;
+    }
+  while (G_CONVERTER_CONVERTED == result);
+}
+
+static EpcStreamWriter*
+epc_stream_writer_new (SoupServer  *server,
+                       EpcContents *contents)
+{
+  EpcStreamWriter *self = g_slice_new0 (EpcStreamWriter);
+
+  self->server = g_object_ref (server);
+  self->contents = epc_contents_ref (contents);
+  self->cancellable = g_cancellable_new ();
+
+  return self;
+}
+
+static void
+epc_stream_writer_free (gpointer data)
+{
+  EpcStreamWriter *self = data;
+
+  g_object_unref (self->cancellable);
+  epc_contents_unref (self->contents);
+  g_object_unref (self->server);
+
+  g_slice_free (EpcStreamWriter, self);
+}
+
+static void epc_publisher_chunk_cb (SoupMessage *message,
+                                    gpointer     data);
+
+/* Chunks are handed over to libsoup without copying, as each chunk
+ * returned by epc_contents_stream_read_bytes_finish() has its own buffer.
+ */
+static void
+epc_publisher_chunk_ready_cb (GObject      *source G_GNUC_UNUSED,
+                              GAsyncResult *result,
+                              gpointer      data)
 {
-  EpcContents *contents = data;
-  gconstpointer chunk;
-  gsize length;
+  SoupMessage *message = data;
+  EpcStreamWriter *writer;
+  GConverter *converter;
+  GError *error = NULL;
+  GBytes *chunk;
+
+  writer = g_object_get_data (G_OBJECT (message), "epc-stream-writer");
+  chunk = epc_contents_stream_read_bytes_finish (writer->contents, result, &error);
+
+  /* The client has disconnected meanwhile. */
+  if (error)
+    {
+      if (EPC_DEBUG_LEVEL (1))
+        g_debug ("%s: %s", G_STRLOC, error->message);
 
-  chunk = epc_contents_stream_read (contents, &length);
+      g_error_free (error);
+      g_object_unref (message);
+      return;
+    }
 
-  if (chunk && length)
+  converter = g_object_get_data (G_OBJECT (message), "epc-converter");
+
+  if (chunk)
     {
+      gsize length;
+      gconstpointer bytes = g_bytes_get_data (chunk, &length);
+
       if (EPC_DEBUG_LEVEL (1))
         g_debug ("%s: writing %" G_GSIZE_FORMAT " bytes", G_STRLOC, length);
 
-      soup_message_body_append (message->response_body,
-                                SOUP_MEMORY_COPY, chunk, length);
+      if (converter)
+        {
+          epc_publisher_append_encoded (message, converter, bytes, length,
+                                        G_CONVERTER_FLUSH);
+          g_bytes_unref (chunk);
+        }
+      else
+        {
+          SoupBuffer *buffer;
+
+          /* The body keeps its own reference on the chunk. */
+          buffer = soup_buffer_new_with_owner (bytes, length, chunk,
+                                               (GDestroyNotify) g_bytes_unref);
+          soup_message_body_append_buffer (message->response_body, buffer);
+          soup_buffer_free (buffer);
+        }
     }
   else
     {
       if (EPC_DEBUG_LEVEL (1))
         g_debug ("%s: done", G_STRLOC);
 
+      if (converter)
+        epc_publisher_append_encoded (message, converter, NULL, 0,
+                                      G_CONVERTER_INPUT_AT_END);
+
+      /* The final chunk also triggers "wrote-chunk". */
+      g_signal_handlers_disconnect_by_func (message, epc_publisher_chunk_cb, writer);
       soup_message_body_complete (message->response_body);
     }
+
+  soup_server_unpause_message (writer->server, message);
+  g_object_unref (message);
+}
+
+static void
+epc_publisher_chunk_cb (SoupMessage *message,
+                        gpointer     data)
+{
+  EpcStreamWriter *writer = data;
+
+  /* Reading the next chunk might take a while with prefetching,
+   * so wait for it without blocking the main loop. */
+  soup_server_pause_message (writer->server, message);
+  epc_contents_stream_read_bytes_async (writer->contents, writer->cancellable,
+                                        epc_publisher_chunk_ready_cb,
+                                        g_object_ref (message));
 }
 
 static void
@@ -394,9 +932,15 @@ epc_publisher_check_client (EpcPublisher      *self,
                             SoupServer        *server,
                             GSocket        *socket)
 {
+  GSList *iter;
+
   if (server == self->priv->server)
     return TRUE;
 
+  for (iter = self->priv->listeners; iter; iter = iter->next)
+    if (server == ((EpcListener*) iter->data)->server)
+      return TRUE;
+
   if (EPC_DEBUG_LEVEL (1))
     epc_publisher_trace_client (G_STRFUNC, "stale client", socket);
 
@@ -410,11 +954,17 @@ epc_publisher_check_client (EpcPublisher      *self,
   return FALSE;
 }
 
+/* Client tracking only guards the bookkeeping needed by epc_publisher_quit().
+ * The lock must not be held while calling into application code, as it is
+ * shared by all publishers of the process.
+ */
 G_GNUC_WARN_UNUSED_RESULT static gboolean
 epc_publisher_track_client (EpcPublisher *self,
                             SoupServer   *server,
                             GSocket      *socket)
 {
+  gboolean tracked = FALSE;
+
   g_rec_mutex_lock (&epc_publisher_lock);
 
   if (epc_publisher_check_client (self, server, socket))
@@ -427,12 +977,12 @@ epc_publisher_track_client (EpcPublisher *self,
       g_object_ref (socket);
       g_hash_table_replace (self->priv->clients, socket, tag);
 
-      return TRUE;
+      tracked = TRUE;
     }
-  else
-    g_rec_mutex_unlock (&epc_publisher_lock);
 
-  return FALSE;
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  return tracked;
 }
 
 static void
@@ -440,6 +990,8 @@ epc_publisher_untrack_client (EpcPublisher *self,
                               SoupServer   *server,
                               GSocket   *socket)
 {
+  g_rec_mutex_lock (&epc_publisher_lock);
+
   if (epc_publisher_check_client (self, server, socket))
     {
       gpointer tag;
@@ -454,117 +1006,1336 @@ epc_publisher_untrack_client (EpcPublisher *self,
   g_rec_mutex_unlock (&epc_publisher_lock);
 }
 
-static void
-epc_publisher_handle_contents (SoupServer        *server,
-                               SoupMessage       *message,
-                               const gchar       *path,
-                               GHashTable        *query G_GNUC_UNUSED,
-                               SoupClientContext *context,
-                               gpointer           data)
+static EpcResource*
+epc_publisher_ref_resource (EpcPublisher *self,
+                            const gchar  *key)
 {
-  GSocket *socket = soup_client_context_get_gsocket (context);
-
-  EpcPublisher *self = EPC_PUBLISHER (data);
   EpcResource *resource = NULL;
-  EpcContents *contents = NULL;
-  const gchar *key = NULL;
 
-  if (EPC_DEBUG_LEVEL (1))
-    g_debug ("%s: method=%s, path=%s", G_STRFUNC, message->method, path);
+  g_rec_mutex_lock (&epc_publisher_lock);
 
-  if (SOUP_METHOD_GET != message->method)
-    {
-      soup_message_set_status (message, SOUP_STATUS_METHOD_NOT_ALLOWED);
-      return;
-    }
+  if (key && self->priv->resources)
+    resource = g_hash_table_lookup (self->priv->resources, key);
+  if (resource)
+    epc_resource_ref (resource);
 
-  if (!epc_publisher_track_client (self, server, socket))
-    return;
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  return resource;
+}
+
+/* Passes a static contents buffer to libsoup without copying it. The response
+ * body keeps a reference on @contents until libsoup has written the data.
+ */
+static void
+epc_publisher_set_response (SoupMessage   *message,
+                            EpcContents   *contents,
+                            gconstpointer  data,
+                            gsize          length)
+{
+  SoupBuffer *buffer;
+
+  buffer = soup_buffer_new_with_owner (data, length,
+                                       epc_contents_ref (contents),
+                                       (GDestroyNotify) epc_contents_unref);
+
+  soup_message_headers_replace (message->response_headers, "Content-Type",
+                                epc_contents_get_mime_type (contents));
+
+  soup_message_body_truncate (message->response_body);
+  soup_message_body_append_buffer (message->response_body, buffer);
+
+  soup_buffer_free (buffer);
+}
+
+/* Picks the content coding preferred by the client, or %NULL for sending
+ * the contents unmodified. Only gzip and deflate are supported, as those
+ * are the codings GLib and libsoup can handle without extra dependencies.
+ */
+static const gchar*
+epc_publisher_get_encoding (SoupMessage *message)
+{
+  const gchar *encoding = NULL;
+  GSList *acceptable, *iter;
+  const char *header;
+
+  header = soup_message_headers_get_list (message->request_headers, "Accept-Encoding");
+
+  if (!header)
+    return NULL;
+
+  acceptable = soup_header_parse_quality_list (header, NULL);
+
+  for (iter = acceptable; iter && !encoding; iter = iter->next)
+    {
+      if (g_str_equal (iter->data, "gzip") ||
+          g_str_equal (iter->data, "x-gzip") ||
+          g_str_equal (iter->data, "*"))
+        encoding = "gzip";
+      else if (g_str_equal (iter->data, "deflate"))
+        encoding = "deflate";
+      else if (g_str_equal (iter->data, "identity"))
+        break;
+    }
+
+  soup_header_free_list (acceptable);
+
+  return encoding;
+}
+
+/* Selects the representation of static contents to send. Compressed
+ * variants are cached by @contents, and only are used when they are
+ * actually smaller. Returns the content coding used, or %NULL.
+ *
+ * Compression runs synchronously in the server context, so callers only
+ * use this for values owned by the publisher, like those added with
+ * epc_publisher_add(). Larger values are sent uncompressed.
+ */
+static const gchar*
+epc_publisher_select_variant (SoupMessage    *message,
+                              EpcContents    *contents,
+                              gconstpointer  *data,
+                              gsize          *length)
+{
+  const gchar *encoding = NULL;
+
+  soup_message_headers_append (message->response_headers, "Vary", "Accept-Encoding");
+
+  if (*length >= EPC_COMPRESSION_MIN_LENGTH &&
+      *length <= EPC_COMPRESSION_MAX_LENGTH)
+    encoding = epc_publisher_get_encoding (message);
+
+  if (encoding)
+    {
+      gconstpointer encoded_data;
+      gsize encoded_length = 0;
+
+      encoded_data = epc_contents_get_encoded_data (contents, encoding, &encoded_length);
+
+      if (encoded_data && encoded_length < *length)
+        {
+          if (EPC_DEBUG_LEVEL (1))
+            g_debug ("%s: %s: %" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT " bytes",
+                     G_STRLOC, encoding, encoded_length, *length);
+
+          soup_message_headers_replace (message->response_headers,
+                                        "Content-Encoding", encoding);
+
+          *data = encoded_data;
+          *length = encoded_length;
+        }
+      else
+        encoding = NULL;
+    }
+
+  return encoding;
+}
+
+/* Announces the entity tag of @contents, and checks if the copy
+ * cached by the client, as described by If-None-Match, still is valid.
+ * Each content coding is a distinct variant and gets its own tag.
+ */
+static gboolean
+epc_publisher_check_etag (SoupMessage *message,
+                          EpcContents *contents,
+                          const gchar *encoding)
+{
+  gboolean matches = FALSE;
+  const gchar *header;
+  const gchar *etag;
+  gchar *quoted;
+
+  /* Checksumming each response would be expensive, so the tag of buffers
+   * built for a single request is only computed when the client asks
+   * for validating its copy. Other buffers got their tag already. */
+  if (soup_message_headers_get_one (message->request_headers, "If-None-Match") ||
+      soup_message_headers_get_one (message->request_headers, "If-Range"))
+    etag = epc_contents_get_etag (contents);
+  else
+    etag = epc_contents_peek_etag (contents);
+
+  if (!etag)
+    return FALSE;
+
+  if (encoding)
+    quoted = g_strdup_printf ("\"%s-%s\"", etag, encoding);
+  else
+    quoted = g_strdup_printf ("\"%s\"", etag);
+  soup_message_headers_replace (message->response_headers, "ETag", quoted);
+
+  header = soup_message_headers_get_list (message->request_headers, "If-None-Match");
+
+  if (header)
+    {
+      GSList *tags, *iter;
+
+      tags = soup_header_parse_list (header);
+
+      for (iter = tags; iter && !matches; iter = iter->next)
+        {
+          const gchar *tag = iter->data;
+
+          if (g_str_has_prefix (tag, "W/"))
+            tag += 2;
+
+          matches = g_str_equal (tag, "*") || g_str_equal (tag, quoted);
+        }
+
+      soup_header_free_list (tags);
+    }
+
+  g_free (quoted);
+
+  return matches;
+}
+
+/* Answers requests for a single byte range of static contents with a
+ * sub-buffer of @data, so that resuming large transfers neither copies
+ * nor flattens the contents. Requests for multiple ranges, and requests
+ * which cannot be satisfied, are left to libsoup, which checks the Range
+ * header of all complete responses.
+ */
+static gboolean
+epc_publisher_set_partial_response (SoupMessage   *message,
+                                    EpcContents   *contents,
+                                    gconstpointer  data,
+                                    gsize          length)
+{
+  SoupBuffer *buffer, *range;
+  const gchar *if_range;
+  SoupRange *ranges;
+  gint n_ranges;
+
+  if (!soup_message_headers_get_one (message->request_headers, "Range"))
+    return FALSE;
+
+  /* Entity tags are the only validator sent by the publisher, so dates
+   * never match. The client gets the entire value when it changed. */
+  if_range = soup_message_headers_get_one (message->request_headers, "If-Range");
+
+  if (if_range && g_strcmp0 (if_range, soup_message_headers_get_one
+                             (message->response_headers, "ETag")))
+    {
+      soup_message_headers_remove (message->request_headers, "Range");
+      return FALSE;
+    }
+
+  if (!soup_message_headers_get_ranges (message->request_headers,
+                                        length, &ranges, &n_ranges))
+    return FALSE;
+
+  if (1 != n_ranges)
+    {
+      soup_message_headers_free_ranges (message->request_headers, ranges);
+      return FALSE;
+    }
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: range=%" G_GINT64_FORMAT "-%" G_GINT64_FORMAT,
+             G_STRLOC, ranges[0].start, ranges[0].end);
+
+  buffer = soup_buffer_new_with_owner (data, length,
+                                       epc_contents_ref (contents),
+                                       (GDestroyNotify) epc_contents_unref);
+  range = soup_buffer_new_subbuffer (buffer, ranges[0].start,
+                                     ranges[0].end - ranges[0].start + 1);
+
+  soup_message_headers_replace (message->response_headers, "Content-Type",
+                                epc_contents_get_mime_type (contents));
+  soup_message_headers_set_content_range (message->response_headers,
+                                          ranges[0].start, ranges[0].end,
+                                          length);
+
+  soup_message_body_truncate (message->response_body);
+  soup_message_body_append_buffer (message->response_body, range);
+  soup_message_set_status (message, SOUP_STATUS_PARTIAL_CONTENT);
+
+  soup_message_headers_free_ranges (message->request_headers, ranges);
+  soup_buffer_free (buffer);
+  soup_buffer_free (range);
+
+  return TRUE;
+}
+
+/* Sends @contents as response to @message. Ownership of @contents
+ * is transferred. Sends "404 Not Found" when @contents is %NULL.
+ *
+ * Only values published by epc_publisher_add() get compressed variants,
+ * as they are compressed once and shared. Files and handler output
+ * might be huge or change with each request, so they are sent as is.
+ */
+static void
+epc_publisher_send_contents (SoupServer  *server,
+                             SoupMessage *message,
+                             const gchar *key,
+                             EpcResource *resource,
+                             EpcContents *contents)
+{
+  soup_message_set_status (message, SOUP_STATUS_NOT_FOUND);
+
+  if (contents)
+    {
+      const gchar *encoding = NULL;
+      gconstpointer contents_data;
+      gsize length = 0;
+
+      contents_data = epc_contents_get_data (contents, &length);
+
+      if (contents_data && resource &&
+          resource->handler == epc_publisher_handle_static)
+        encoding = epc_publisher_select_variant (message, contents,
+                                                 &contents_data, &length);
+      else if (epc_contents_is_stream (contents))
+        {
+          encoding = epc_publisher_get_encoding (message);
+          soup_message_headers_append (message->response_headers, "Vary", "Accept-Encoding");
+        }
+
+      if (epc_publisher_check_etag (message, contents, encoding))
+        {
+          if (EPC_DEBUG_LEVEL (1))
+            g_debug ("%s: %s: not modified", G_STRLOC, key);
+
+          soup_message_set_status (message, SOUP_STATUS_NOT_MODIFIED);
+        }
+      else if (contents_data)
+        {
+          soup_message_headers_replace (message->response_headers, "Accept-Ranges", "bytes");
+
+          if (!epc_publisher_set_partial_response (message, contents, contents_data, length))
+            {
+              epc_publisher_set_response (message, contents, contents_data, length);
+              soup_message_set_status (message, SOUP_STATUS_OK);
+            }
+        }
+      else if (epc_contents_is_stream (contents))
+        {
+          EpcStreamWriter *writer;
+
+          if (encoding)
+            {
+              GZlibCompressorFormat format = G_ZLIB_COMPRESSOR_FORMAT_GZIP;
+
+              if (g_str_equal (encoding, "deflate"))
+                format = G_ZLIB_COMPRESSOR_FORMAT_ZLIB;
+
+              g_object_set_data_full (G_OBJECT (message), "epc-converter",
+                                      g_zlib_compressor_new (format, -1),
+                                      g_object_unref);
+              soup_message_headers_replace (message->response_headers,
+                                            "Content-Encoding", encoding);
+            }
+
+          writer = epc_stream_writer_new (server, contents);
+          g_object_set_data_full (G_OBJECT (message), "epc-stream-writer",
+                                  writer, epc_stream_writer_free);
+
+          g_signal_connect (message, "wrote-chunk", G_CALLBACK (epc_publisher_chunk_cb), writer);
+          g_signal_connect (message, "wrote-headers", G_CALLBACK (epc_publisher_chunk_cb), writer);
+          g_signal_connect_swapped (message, "finished", G_CALLBACK (g_cancellable_cancel), writer->cancellable);
+
+          /* Don't keep chunks which were written already,
+           * memory usage would grow with the stream size otherwise. */
+          soup_message_body_set_accumulate (message->response_body, FALSE);
+          soup_message_headers_set_encoding (message->response_headers, SOUP_ENCODING_CHUNKED);
+          soup_message_set_status (message, SOUP_STATUS_OK);
+        }
+
+      g_signal_connect_swapped (message, "finished", G_CALLBACK (epc_contents_unref), contents);
+    }
+}
+
+static void
+epc_contents_request_finished_cb (SoupMessage *message G_GNUC_UNUSED,
+                                  gpointer     data)
+{
+  EpcContentsRequest *request = data;
+  request->finished = TRUE;
+}
+
+static EpcListener*
+epc_publisher_find_listener (EpcPublisher *self,
+                             SoupServer   *server)
+{
+  GSList *iter;
+
+  for (iter = self->priv->listeners; iter; iter = iter->next)
+    if (server == ((EpcListener*) iter->data)->server)
+      return iter->data;
+
+  return NULL;
+}
+
+static EpcContentsRequest*
+epc_contents_request_new (EpcPublisher *publisher,
+                          SoupServer   *server,
+                          SoupMessage  *message,
+                          GSocket      *socket,
+                          const gchar  *key)
+{
+  EpcContentsRequest *self = g_slice_new0 (EpcContentsRequest);
+
+  self->publisher = g_object_ref (publisher);
+  self->server = g_object_ref (server);
+  self->message = g_object_ref (message);
+  self->socket = g_object_ref (socket);
+  self->context = g_main_context_ref_thread_default ();
+  self->key = g_strdup (key);
+
+  self->finished_id =
+    g_signal_connect (message, "finished",
+                      G_CALLBACK (epc_contents_request_finished_cb),
+                      self);
+
+  /* Listeners fail their paused requests when they are stopped. */
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  self->listener = epc_publisher_find_listener (publisher, server);
+
+  if (self->listener)
+    self->listener->requests = g_list_prepend (self->listener->requests, self);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  return self;
+}
+
+static void
+epc_contents_request_free (EpcContentsRequest *self)
+{
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  if (self->listener)
+    self->listener->requests = g_list_remove (self->listener->requests, self);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  g_signal_handler_disconnect (self->message, self->finished_id);
+
+  if (self->contents)
+    epc_contents_unref (self->contents);
+  if (self->resource)
+    epc_resource_unref (self->resource);
+
+  g_object_unref (self->publisher);
+  g_object_unref (self->server);
+  g_object_unref (self->message);
+  g_object_unref (self->socket);
+  g_main_context_unref (self->context);
+  g_free (self->key);
+
+  g_slice_free (EpcContentsRequest, self);
+}
+
+/* Runs in the context of the server, as libsoup isn't thread-safe. */
+static gboolean
+epc_contents_request_complete_cb (gpointer data)
+{
+  EpcContentsRequest *self = data;
+
+  /* The client might have disconnected while the handler was busy. */
+  if (!self->finished && !self->abandoned)
+    {
+      epc_publisher_send_contents (self->server, self->message, self->key,
+                                   self->resource, self->contents);
+      soup_server_unpause_message (self->server, self->message);
+      self->contents = NULL;
+    }
+
+  if (!self->abandoned)
+    epc_publisher_untrack_client (self->publisher, self->server, self->socket);
+
+  epc_contents_request_free (self);
+
+  return FALSE;
+}
+
+/* Runs thread-safe contents handlers in the thread pool of the publisher. */
+static void
+epc_publisher_run_handler (gpointer data,
+                           gpointer user_data G_GNUC_UNUSED)
+{
+  EpcContentsRequest *request = data;
+  EpcResource *resource = request->resource;
+  EpcContents *contents;
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: key=%s", G_STRFUNC, request->key);
+
+  contents = resource->handler (request->publisher, request->key, resource->user_data);
+  epc_contents_request_complete (request, contents);
+}
+
+/* Passes the request to the thread pool of the publisher, if there is one
+ * and the handler is known to be thread-safe. The message is paused until
+ * the handler has finished.
+ */
+static gboolean
+epc_publisher_dispatch_handler (EpcPublisher *self,
+                                SoupServer   *server,
+                                SoupMessage  *message,
+                                GSocket      *socket,
+                                const gchar  *key,
+                                EpcResource  *resource)
+{
+  gboolean dispatched = FALSE;
+
+  if (!resource->handler || !(epc_resource_get_flags (resource) & EPC_HANDLER_THREAD_SAFE))
+    return FALSE;
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  if (self->priv->handler_pool)
+    {
+      EpcContentsRequest *request;
+
+      request = epc_contents_request_new (self, server, message, socket, key);
+      request->resource = epc_resource_ref (resource);
+      soup_server_pause_message (server, message);
+
+      g_thread_pool_push (self->priv->handler_pool, request, NULL);
+      dispatched = TRUE;
+    }
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  return dispatched;
+}
+
+/* Handlers which are not declared thread-safe are only called from the
+ * main context of the primary server, also when listener threads accept
+ * connections. Values published by epc_publisher_add() are immutable.
+ */
+static gboolean
+epc_resource_is_thread_safe (EpcResource *resource)
+{
+  return (epc_resource_get_flags (resource) & EPC_HANDLER_THREAD_SAFE) ||
+         resource->handler == epc_publisher_handle_static;
+}
+
+static gboolean
+epc_publisher_in_server_context (EpcPublisher *self)
+{
+  return !self->priv->server_context ||
+         g_main_context_is_owner (self->priv->server_context);
+}
+
+static void
+epc_server_call_unref (gpointer data)
+{
+  EpcServerCall *call = data;
+
+  if (g_atomic_int_dec_and_test (&call->ref_count))
+    g_slice_free (EpcServerCall, call);
+}
+
+static gboolean
+epc_server_call_dispatch_cb (gpointer data)
+{
+  EpcServerCall *call = data;
+  gboolean cancelled;
+
+  g_mutex_lock (&epc_server_call_mutex);
+
+  cancelled = (EPC_SERVER_CALL_CANCELLED == call->state);
+
+  if (!cancelled)
+    call->state = EPC_SERVER_CALL_RUNNING;
+
+  g_mutex_unlock (&epc_server_call_mutex);
+
+  if (cancelled)
+    return FALSE;
+
+  call->func (call->data);
+
+  g_mutex_lock (&epc_server_call_mutex);
+  call->state = EPC_SERVER_CALL_DONE;
+  g_cond_broadcast (&epc_server_call_cond);
+  g_mutex_unlock (&epc_server_call_mutex);
+
+  return FALSE;
+}
+
+/* Calls @func from the main context of the primary server and waits for
+ * it. Returns %FALSE when the listeners were stopped before @func could
+ * be called, as the primary server's thread might wait for the calling
+ * listener then.
+ */
+static gboolean
+epc_publisher_call_in_server_context (EpcPublisher *self,
+                                      GSourceFunc   func,
+                                      gpointer      data)
+{
+  EpcServerCall *call;
+  GSource *source;
+  gboolean done;
+
+  if (epc_publisher_in_server_context (self))
+    {
+      func (data);
+      return TRUE;
+    }
+
+  call = g_slice_new0 (EpcServerCall);
+  call->ref_count = 2;
+  call->state = EPC_SERVER_CALL_PENDING;
+  call->func = func;
+  call->data = data;
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, epc_server_call_dispatch_cb, call, epc_server_call_unref);
+  g_source_attach (source, self->priv->server_context);
+  g_source_unref (source);
+
+  g_mutex_lock (&epc_server_call_mutex);
+
+  while (EPC_SERVER_CALL_DONE != call->state &&
+         (EPC_SERVER_CALL_PENDING != call->state ||
+          !self->priv->listeners_stopping))
+    g_cond_wait (&epc_server_call_cond, &epc_server_call_mutex);
+
+  if (EPC_SERVER_CALL_PENDING == call->state)
+    call->state = EPC_SERVER_CALL_CANCELLED;
+
+  done = (EPC_SERVER_CALL_DONE == call->state);
+
+  g_mutex_unlock (&epc_server_call_mutex);
+
+  epc_server_call_unref (call);
+
+  return done;
+}
+
+static gboolean
+epc_handler_call_contents_cb (gpointer data)
+{
+  EpcHandlerCall *call = data;
+
+  call->contents = call->resource->handler (call->publisher, call->key,
+                                            call->resource->user_data);
+
+  return FALSE;
+}
+
+static gboolean
+epc_handler_call_auth_cb (gpointer data)
+{
+  EpcHandlerCall *call = data;
+
+  call->authorized = call->auth->handler (call->auth_context, call->username,
+                                          call->auth->user_data);
+
+  return FALSE;
+}
+
+/* Calls the contents handler of @resource from a context allowed for it. */
+static EpcContents*
+epc_publisher_call_handler (EpcPublisher *self,
+                            EpcResource  *resource,
+                            const gchar  *key)
+{
+  EpcHandlerCall call = { self, resource, key, NULL, NULL, NULL, FALSE };
+
+  if (epc_resource_is_thread_safe (resource))
+    epc_handler_call_contents_cb (&call);
+  else
+    epc_publisher_call_in_server_context (self, epc_handler_call_contents_cb, &call);
+
+  return call.contents;
+}
+
+/* Calls the auth handler of @context's resource from a context allowed for it.
+ * Requests are rejected when the publisher stops before the handler ran.
+ */
+static gboolean
+epc_publisher_call_auth_handler (EpcAuthContext *context,
+                                 const gchar    *username)
+{
+  EpcHandlerCall call = { context->publisher, context->resource, context->key,
+                          context, username, NULL, FALSE, NULL };
+
+  /* The handler might get replaced while it runs. */
+  call.auth = epc_resource_ref_auth (context->resource);
+
+  if (!call.auth)
+    return TRUE;
+
+  if (epc_resource_is_thread_safe (context->resource))
+    epc_handler_call_auth_cb (&call);
+  else
+    epc_publisher_call_in_server_context (context->publisher, epc_handler_call_auth_cb, &call);
+
+  epc_auth_binding_unref (call.auth);
+
+  return call.authorized;
+}
+
+/* Runs contents handlers which are not thread-safe in the main context
+ * of the primary server, for requests received by listener threads.
+ */
+static gboolean
+epc_publisher_run_handler_cb (gpointer data)
+{
+  epc_publisher_run_handler (data, NULL);
+  return FALSE;
+}
+
+static gboolean
+epc_publisher_forward_handler (EpcPublisher *self,
+                               SoupServer   *server,
+                               SoupMessage  *message,
+                               GSocket      *socket,
+                               const gchar  *key,
+                               EpcResource  *resource)
+{
+  EpcContentsRequest *request;
+  GSource *source;
+
+  if (!resource->handler || epc_resource_is_thread_safe (resource) ||
+      epc_publisher_in_server_context (self))
+    return FALSE;
+
+  request = epc_contents_request_new (self, server, message, socket, key);
+  request->resource = epc_resource_ref (resource);
+  soup_server_pause_message (server, message);
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, epc_publisher_run_handler_cb, request, NULL);
+  g_source_attach (source, self->priv->server_context);
+  g_source_unref (source);
+
+  return TRUE;
+}
+
+/* Calls the asynchronous handler for @data. The request might be released
+ * before the handler returns, so the resource is kept alive separately.
+ */
+static gboolean
+epc_publisher_run_async_handler_cb (gpointer data)
+{
+  EpcContentsRequest *request = data;
+  EpcResource *resource = epc_resource_ref (request->resource);
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: key=%s", G_STRFUNC, request->key);
+
+  resource->async_handler (request->publisher, request->key,
+                           request, resource->user_data);
+  epc_resource_unref (resource);
+
+  return FALSE;
+}
+
+/* Asynchronous handlers follow the same rules as other handlers: unless
+ * flagged thread-safe they are called from the main context of the primary
+ * server. Their requests are completed in the context of the listener.
+ */
+static void
+epc_publisher_start_async_handler (EpcPublisher *self,
+                                   SoupServer   *server,
+                                   SoupMessage  *message,
+                                   GSocket      *socket,
+                                   const gchar  *key,
+                                   EpcResource  *resource)
+{
+  EpcContentsRequest *request;
+  GSource *source;
+
+  /* The client stays tracked until the request completes. */
+  request = epc_contents_request_new (self, server, message, socket, key);
+  request->resource = epc_resource_ref (resource);
+  soup_server_pause_message (server, message);
+
+  if (epc_resource_is_thread_safe (resource) ||
+      epc_publisher_in_server_context (self))
+    {
+      epc_publisher_run_async_handler_cb (request);
+      return;
+    }
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, epc_publisher_run_async_handler_cb, request, NULL);
+  g_source_attach (source, self->priv->server_context);
+  g_source_unref (source);
+}
+
+static void
+epc_publisher_handle_contents (SoupServer        *server,
+                               SoupMessage       *message,
+                               const gchar       *path,
+                               GHashTable        *query G_GNUC_UNUSED,
+                               SoupClientContext *context,
+                               gpointer           data)
+{
+  GSocket *socket = soup_client_context_get_gsocket (context);
+
+  EpcPublisher *self = EPC_PUBLISHER (data);
+  EpcResource *resource = NULL;
+  EpcContents *contents = NULL;
+  const gchar *key = NULL;
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: method=%s, path=%s", G_STRFUNC, message->method, path);
+
+  if (SOUP_METHOD_GET != message->method)
+    {
+      soup_message_set_status (message, SOUP_STATUS_METHOD_NOT_ALLOWED);
+      return;
+    }
+
+  if (!epc_publisher_track_client (self, server, socket))
+    return;
+
+  key = epc_publisher_get_key (path);
+  resource = epc_publisher_ref_resource (self, key);
+
+  if (resource && resource->async_handler)
+    {
+      epc_publisher_start_async_handler (self, server, message,
+                                         socket, key, resource);
+      epc_resource_unref (resource);
+      return;
+    }
+
+  if (resource && (epc_publisher_dispatch_handler (self, server, message,
+                                                   socket, key, resource) ||
+                   epc_publisher_forward_handler (self, server, message,
+                                                  socket, key, resource)))
+    {
+      epc_resource_unref (resource);
+      return;
+    }
+
+  if (resource && resource->handler)
+    contents = resource->handler (self, key, resource->user_data);
+
+  epc_publisher_send_contents (server, message, key, resource, contents);
+
+  if (resource)
+    epc_resource_unref (resource);
+
+  epc_publisher_untrack_client (self, server, socket);
+}
+
+static gint
+epc_publisher_compare_keys (gconstpointer a,
+                            gconstpointer b,
+                            gpointer      data G_GNUC_UNUSED)
+{
+  return strcmp (a, b);
+}
+
+static gint
+epc_publisher_compare_lower_bound (gconstpointer a,
+                                   gconstpointer b,
+                                   gpointer      data G_GNUC_UNUSED)
+{
+  /* Never report equality, so that g_sequence_search()
+   * stops in front of the first key not less than @b. */
+  return strcmp (a, b) < 0 ? -1 : 1;
+}
+
+static gint
+epc_publisher_compare_upper_bound (gconstpointer a,
+                                   gconstpointer b,
+                                   gpointer      data G_GNUC_UNUSED)
+{
+  return strcmp (a, b) <= 0 ? -1 : 1;
+}
+
+/* Calls @func for each key matching the glob-style @pattern in byte order.
+ * Keys are kept in a sorted index, so only the range of keys sharing the
+ * literal prefix of @pattern must be inspected. Must be called with
+ * epc_publisher_lock held.
+ *
+ * Iteration starts behind the key @after when not %NULL, and stops after
+ * @limit matches when @limit is not zero. The last key passed to @func is
+ * returned when further keys match, and %NULL otherwise.
+ */
+static const gchar*
+epc_publisher_foreach_key (EpcPublisher *self,
+                           const gchar  *pattern,
+                           const gchar  *after,
+                           guint         limit,
+                           GFunc         func,
+                           gpointer      data)
+{
+  const gchar *last_key = NULL;
+  const gchar *continuation = NULL;
+  GPatternSpec *spec = NULL;
+  gboolean exact = FALSE;
+  GSequenceIter *iter;
+  guint count = 0;
+  gchar *prefix;
 
-  key = epc_publisher_get_key (path);
+  if (pattern && *pattern)
+    {
+      gsize length = strcspn (pattern, "*?");
 
-  if (key)
-    resource = g_hash_table_lookup (self->priv->resources, key);
-  if (resource && resource->handler)
-    contents = resource->handler (self, key, resource->user_data);
+      prefix = g_strndup (pattern, length);
 
-  soup_message_set_status (message, SOUP_STATUS_NOT_FOUND);
+      if (pattern[length])
+        spec = g_pattern_spec_new (pattern);
+      else
+        exact = TRUE;
+    }
+  else
+    prefix = g_strdup ("");
 
-  if (contents)
+  if (after && strcmp (after, prefix) >= 0)
+    iter = g_sequence_search (self->priv->resource_index, (gpointer) after,
+                              epc_publisher_compare_upper_bound, NULL);
+  else
+    iter = g_sequence_search (self->priv->resource_index, prefix,
+                              epc_publisher_compare_lower_bound, NULL);
+
+  while (!g_sequence_iter_is_end (iter))
     {
-      gconstpointer contents_data;
-      const gchar *type;
-      gsize length = 0;
+      gchar *key = g_sequence_get (iter);
 
-      contents_data = epc_contents_get_data (contents, &length);
-      type = epc_contents_get_mime_type (contents);
+      if (!g_str_has_prefix (key, prefix))
+        break;
 
-      if (contents_data)
+      if (exact ? g_str_equal (key, prefix) :
+          (!spec || g_pattern_match_string (spec, key)))
         {
-          soup_message_set_response (message, type, SOUP_MEMORY_COPY, (gpointer) contents_data, length);
-          soup_message_set_status (message, SOUP_STATUS_OK);
+          if (limit > 0 && count == limit)
+            {
+              continuation = last_key;
+              break;
+            }
+
+          func (key, data);
+
+          last_key = key;
+          count += 1;
         }
-      else if (epc_contents_is_stream (contents))
+
+      if (exact)
+        break;
+
+      iter = g_sequence_iter_next (iter);
+    }
+
+  if (spec)
+    g_pattern_spec_free (spec);
+
+  g_free (prefix);
+
+  return continuation;
+}
+
+static void
+epc_publisher_append_listing_cb (gpointer key,
+                                 gpointer data)
+{
+  EpcListingBuilder *builder = data;
+  EpcResource *resource;
+  guint32 length;
+
+  switch (builder->format)
+    {
+      case EPC_LISTING_FORMAT_MARKUP:
+        resource = g_hash_table_lookup (builder->resources, key);
+        g_string_append (builder->contents, resource->markup);
+        break;
+
+      case EPC_LISTING_FORMAT_BINARY:
+        length = strlen (key);
+        length = GUINT32_TO_BE (length);
+
+        g_string_append_len (builder->contents, (gchar*) &length, sizeof length);
+        g_string_append (builder->contents, key);
+        break;
+
+      case EPC_LISTING_FORMAT_LAST:
+        g_assert_not_reached ();
+        break;
+    }
+}
+
+/* Serializes the listing of resources matching @pattern. Pages of listings
+ * are requested by passing @after and @limit, see epc_publisher_foreach_key().
+ * The key to continue with is announced by the "continue" attribute of the
+ * list element for markup listings, and is stored in @continuation for the
+ * X-Epc-Continue header. Must be called with epc_publisher_lock held.
+ *
+ * The binary format is a sequence of UTF-8 encoded keys, each prefixed by
+ * its length as 32 bit unsigned integer in network byte order. It avoids
+ * the cost of escaping and parsing markup for large listings.
+ */
+static GString*
+epc_publisher_build_listing (EpcPublisher      *self,
+                             EpcListingFormat   format,
+                             const gchar       *pattern,
+                             const gchar       *after,
+                             guint              limit,
+                             gchar            **continuation)
+{
+  EpcListingBuilder builder;
+  const gchar *next;
+
+  builder.resources = self->priv->resources;
+  builder.contents = g_string_new (NULL);
+  builder.format = format;
+
+  next = epc_publisher_foreach_key (self, pattern, after, limit,
+                                    epc_publisher_append_listing_cb,
+                                    &builder);
+
+  if (EPC_LISTING_FORMAT_MARKUP == format)
+    {
+      if (next)
         {
-          g_signal_connect (message, "wrote-chunk", G_CALLBACK (epc_publisher_chunk_cb), contents);
-          g_signal_connect (message, "wrote-headers", G_CALLBACK (epc_publisher_chunk_cb), contents);
+          gchar *markup = g_markup_printf_escaped ("<list continue=\"%s\">", next);
+          g_string_prepend (builder.contents, markup);
+          g_free (markup);
+        }
+      else
+        g_string_prepend (builder.contents, "<list>");
 
-          soup_message_headers_set_encoding (message->response_headers, SOUP_ENCODING_CHUNKED);
-          soup_message_set_status (message, SOUP_STATUS_OK);
+      g_string_append (builder.contents, "</list>");
+    }
+
+  if (continuation)
+    *continuation = g_strdup (next);
+
+  return builder.contents;
+}
+
+static const gchar*
+epc_publisher_get_listing_type (EpcListingFormat format)
+{
+  switch (format)
+    {
+      case EPC_LISTING_FORMAT_MARKUP:
+        return "text/xml";
+
+      case EPC_LISTING_FORMAT_BINARY:
+        return EPC_LISTING_MIME_TYPE;
+
+      case EPC_LISTING_FORMAT_LAST:
+        break;
+    }
+
+  g_return_val_if_reached (NULL);
+}
+
+/* Picks the listing format acceptable for the client. Markup is
+ * used unless the client explicitly asks for the compact format.
+ */
+static EpcListingFormat
+epc_publisher_get_listing_format (SoupMessage *message)
+{
+  EpcListingFormat format = EPC_LISTING_FORMAT_MARKUP;
+  GSList *acceptable, *iter;
+  const char *accept;
+
+  accept = soup_message_headers_get_list (message->request_headers, "Accept");
+
+  if (!accept)
+    return format;
+
+  acceptable = soup_header_parse_quality_list (accept, NULL);
+
+  for (iter = acceptable; iter; iter = iter->next)
+    {
+      if (g_str_equal (iter->data, EPC_LISTING_MIME_TYPE))
+        {
+          format = EPC_LISTING_FORMAT_BINARY;
+          break;
         }
 
-      g_signal_connect_swapped (message, "finished", G_CALLBACK (epc_contents_unref), contents);
+      if (g_str_equal (iter->data, "text/xml"))
+        break;
     }
 
-  epc_publisher_untrack_client (self, server, socket);
+  soup_header_free_list (acceptable);
+
+  return format;
+}
+
+/* Retrieves the listing of all resources. It is cached until the next
+ * modification of the resource table, as clients tend to poll it.
+ */
+static EpcContents*
+epc_publisher_ref_listing (EpcPublisher     *self,
+                           EpcListingFormat  format)
+{
+  EpcContents *listing;
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  if (self->priv->listings[format] &&
+      self->priv->listing_generations[format] != self->priv->resources_generation)
+    {
+      epc_contents_unref (self->priv->listings[format]);
+      self->priv->listings[format] = NULL;
+    }
+
+  if (!self->priv->listings[format])
+    {
+      GString *contents = epc_publisher_build_listing (self, format, NULL, NULL, 0, NULL);
+      gsize length = contents->len;
+
+      self->priv->listings[format] =
+        epc_contents_new (epc_publisher_get_listing_type (format),
+                          g_string_free (contents, FALSE),
+                          length, g_free);
+      self->priv->listing_generations[format] = self->priv->resources_generation;
+    }
+
+  listing = epc_contents_ref (self->priv->listings[format]);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  return listing;
 }
 
 static void
 epc_publisher_handle_list (SoupServer        *server,
                            SoupMessage       *message,
                            const char        *path,
-                           GHashTable        *query G_GNUC_UNUSED,
+                           GHashTable        *query,
                            SoupClientContext *context,
                            gpointer           data)
 {
   GSocket *socket = soup_client_context_get_gsocket (context);
 
   const gchar *pattern = NULL;
+  const gchar *after = NULL;
   EpcPublisher *self = data;
-  GList *files = NULL;
-  GList *iter;
-
-  GString *contents = g_string_new (NULL);
+  EpcListingFormat format;
+  gboolean paged;
+  guint limit = 0;
 
   if (!epc_publisher_track_client (self, server, socket))
     return;
 
+  format = epc_publisher_get_listing_format (message);
+  soup_message_headers_append (message->response_headers, "Vary", "Accept");
+
   if (g_str_has_prefix (path, "/list/") && '\0' != path[6])
     pattern = path + 6;
 
-  files = epc_publisher_list (self, pattern);
-  g_string_append (contents, "<list>");
+  if (query)
+    {
+      const gchar *value = g_hash_table_lookup (query, "limit");
+
+      if (value)
+        limit = MIN (g_ascii_strtoull (value, NULL, 10), G_MAXUINT);
+
+      after = g_hash_table_lookup (query, "after");
+    }
+
+  /* Bound the size of responses. Consumers asking for the compact format
+   * follow X-Epc-Continue. Legacy consumers only know the markup format
+   * and don't request pages, so they still receive complete listings. */
+  if (EPC_LISTING_FORMAT_BINARY == format && !limit)
+    limit = EPC_LISTING_DEFAULT_LIMIT;
+  if (limit > EPC_LISTING_MAX_LIMIT)
+    limit = EPC_LISTING_MAX_LIMIT;
+
+  /* The cached listing can be used while it fits into one page. */
+  g_rec_mutex_lock (&epc_publisher_lock);
+  paged = (limit && limit < g_hash_table_size (self->priv->resources));
+  g_rec_mutex_unlock (&epc_publisher_lock);
 
-  for (iter = files; iter; iter = iter->next)
+  if ((pattern && strcmp (pattern, "*")) || after || paged)
     {
-      gchar *markup = g_markup_escape_text (iter->data, -1);
+      gchar *continuation = NULL;
+      GString *contents;
 
-      g_string_append (contents, "<item><name>");
-      g_string_append (contents, markup);
-      g_string_append (contents, "</name></item>");
+      g_rec_mutex_lock (&epc_publisher_lock);
+      contents = epc_publisher_build_listing (self, format, pattern,
+                                              after, limit, &continuation);
+      g_rec_mutex_unlock (&epc_publisher_lock);
 
-      g_free (iter->data);
-      g_free (markup);
+      if (continuation)
+        {
+          gchar *keyuri = soup_uri_encode (continuation, NULL);
+          soup_message_headers_replace (message->response_headers, "X-Epc-Continue", keyuri);
+          g_free (keyuri);
+        }
+
+      soup_message_set_response (message, epc_publisher_get_listing_type (format),
+                                 SOUP_MEMORY_TAKE, contents->str, contents->len);
+
+      g_string_free (contents, FALSE);
+      g_free (continuation);
+    }
+  else
+    {
+      EpcContents *listing = epc_publisher_ref_listing (self, format);
+      gconstpointer listing_data;
+      gsize length;
+
+      listing_data = epc_contents_get_data (listing, &length);
+      epc_publisher_select_variant (message, listing, &listing_data, &length);
+      epc_publisher_set_response (message, listing, listing_data, length);
+
+      epc_contents_unref (listing);
+    }
+
+  soup_message_set_status (message, SOUP_STATUS_OK);
+
+  epc_publisher_untrack_client (self, server, socket);
+}
+
+static const gchar*
+epc_publisher_get_batch_pattern (const gchar *path)
+{
+  if (g_str_has_prefix (path, "/batch/") && '\0' != path[7])
+    return path + 7;
+
+  return NULL;
+}
+
+static gboolean
+epc_publisher_is_batch_request (SoupMessage *message)
+{
+  const SoupURI *uri = soup_message_get_uri (message);
+
+  return g_str_equal (uri->path, "/batch") ||
+         g_str_has_prefix (uri->path, "/batch/");
+}
+
+/* The auth filter, the auth callbacks and the handler of a batch request
+ * all need the keys matching it. They are listed only once per request,
+ * and remembered by the message.
+ */
+static GPtrArray*
+epc_publisher_get_batch_keys (EpcPublisher *self,
+                              SoupMessage  *message)
+{
+  GPtrArray *keys = g_object_get_data (G_OBJECT (message), "epc-batch-keys");
+
+  if (!keys)
+    {
+      const SoupURI *uri = soup_message_get_uri (message);
+      GList *list, *iter;
+
+      list = epc_publisher_list (self, epc_publisher_get_batch_pattern (uri->path));
+      keys = g_ptr_array_new_with_free_func (g_free);
+
+      for (iter = list; iter; iter = iter->next)
+        g_ptr_array_add (keys, iter->data);
+
+      g_object_set_data_full (G_OBJECT (message), "epc-batch-keys",
+                              keys, (GDestroyNotify) g_ptr_array_unref);
+      g_list_free (list);
+    }
+
+  return keys;
+}
+
+static void
+epc_publisher_append_part (SoupMultipart *multipart,
+                           const gchar   *key,
+                           EpcContents   *contents)
+{
+  SoupMessageHeaders *headers;
+  SoupBuffer *buffer = NULL;
+  gconstpointer data;
+  gsize length = 0;
+  gchar *keyuri;
+
+  data = epc_contents_get_data (contents, &length);
+
+  if (data)
+    buffer = soup_buffer_new_with_owner (data, length,
+                                         epc_contents_ref (contents),
+                                         (GDestroyNotify) epc_contents_unref);
+  else if (epc_contents_is_stream (contents))
+    {
+      GByteArray *array = g_byte_array_new ();
+
+      while (NULL != (data = epc_contents_stream_read (contents, &length)) && length > 0)
+        g_byte_array_append (array, data, length);
+
+      length = array->len;
+      buffer = soup_buffer_new (SOUP_MEMORY_TAKE, g_byte_array_free (array, FALSE), length);
+    }
+
+  if (buffer)
+    {
+      keyuri = soup_uri_encode (key, NULL);
+      headers = soup_message_headers_new (SOUP_MESSAGE_HEADERS_MULTIPART);
+
+      soup_message_headers_replace (headers, "Content-Type", epc_contents_get_mime_type (contents));
+      soup_message_headers_replace (headers, "X-Epc-Key", keyuri);
+      soup_multipart_append_part (multipart, headers, buffer);
+
+      soup_message_headers_free (headers);
+      soup_buffer_free (buffer);
+      g_free (keyuri);
+    }
+}
+
+static void
+epc_publisher_handle_batch (SoupServer        *server,
+                            SoupMessage       *message,
+                            const char        *path,
+                            GHashTable        *query G_GNUC_UNUSED,
+                            SoupClientContext *context,
+                            gpointer           data)
+{
+  GSocket *socket = soup_client_context_get_gsocket (context);
+
+  EpcPublisher *self = data;
+  SoupMultipart *multipart;
+  GHashTable *granted;
+  GPtrArray *keys;
+  guint i;
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: method=%s, path=%s", G_STRFUNC, message->method, path);
+
+  if (SOUP_METHOD_GET != message->method)
+    {
+      soup_message_set_status (message, SOUP_STATUS_METHOD_NOT_ALLOWED);
+      return;
     }
 
-  g_string_append (contents, "</list>");
+  if (!epc_publisher_track_client (self, server, socket))
+    return;
+
+  granted = g_object_get_data (G_OBJECT (message), "epc-batch-granted");
+  keys = epc_publisher_get_batch_keys (self, message);
+  multipart = soup_multipart_new (SOUP_FORM_MIME_TYPE_MULTIPART);
+
+  for (i = 0; i < keys->len; ++i)
+    {
+      const gchar *key = g_ptr_array_index (keys, i);
+      EpcContents *contents = NULL;
+      EpcResource *resource;
+
+      resource = epc_publisher_ref_resource (self, key);
+
+      /* Protected keys are only delivered when the credentials of this
+       * request were accepted by their authentication handler. */
+      if (resource && resource->handler &&
+          (!epc_resource_has_auth (resource) || (granted &&
+           g_hash_table_contains (granted, key))))
+        contents = epc_publisher_call_handler (self, resource, key);
+
+      if (resource)
+        epc_resource_unref (resource);
+
+      if (contents)
+        {
+          epc_publisher_append_part (multipart, key, contents);
+          epc_contents_unref (contents);
+        }
+    }
 
-  soup_message_set_response (message, "text/xml", SOUP_MEMORY_TAKE,
-                             contents->str, contents->len);
+  soup_multipart_to_message (multipart,
+                             message->response_headers,
+                             message->response_body);
   soup_message_set_status (message, SOUP_STATUS_OK);
 
-  g_string_free (contents, FALSE);
-  g_list_free (files);
+  soup_multipart_free (multipart);
 
   epc_publisher_untrack_client (self, server, socket);
 }
@@ -585,15 +2356,22 @@ epc_publisher_handle_root (SoupServer        *server,
       epc_publisher_track_client (self, server, socket))
     {
       GString *contents = g_string_new (NULL);
+      gchar *contents_path;
+      gchar *service_name;
       gchar *markup;
 
       GList *files;
       GList *iter;
 
+      /* Listener threads also serve this page. */
+      g_rec_mutex_lock (&epc_publisher_lock);
+      contents_path = g_markup_escape_text (self->priv->contents_path, -1);
+      service_name = g_strdup (self->priv->service_name);
+      g_rec_mutex_unlock (&epc_publisher_lock);
+
       files = epc_publisher_list (self, NULL);
-      files = g_list_sort (files, (GCompareFunc) g_utf8_collate);
 
-      markup = g_markup_escape_text (self->priv->service_name, -1);
+      markup = g_markup_escape_text (service_name ? service_name : "", -1);
 
       g_string_append (contents, "<html><head><title>");
       g_string_append (contents, markup);
@@ -611,13 +2389,10 @@ epc_publisher_handle_root (SoupServer        *server,
 
           for (iter = files; iter; iter = iter->next)
             {
-              markup = g_markup_escape_text (self->priv->contents_path, -1);
-
               g_string_append (contents, "<li><a href=\"");
-              g_string_append (contents, markup);
+              g_string_append (contents, contents_path);
               g_string_append (contents, "/");
 
-              g_free (markup);
               markup = g_markup_escape_text (iter->data, -1);
 
               g_string_append (contents, markup);
@@ -650,6 +2425,8 @@ epc_publisher_handle_root (SoupServer        *server,
 
       g_string_free (contents, FALSE);
       g_list_free (files);
+      g_free (contents_path);
+      g_free (service_name);
 
       epc_publisher_untrack_client (self, server, socket);
     }
@@ -674,10 +2451,110 @@ epc_auth_context_init (EpcAuthContext *context,
   context->username = username;
   context->password = password;
 
+  g_rec_mutex_lock (&epc_publisher_lock);
+
   if (context->key)
     context->resource = g_hash_table_lookup (publisher->priv->resources, context->key);
   if (!context->resource)
     context->resource = publisher->priv->default_resource;
+  if (context->resource)
+    epc_resource_ref (context->resource);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+}
+
+static void
+epc_auth_context_clear (EpcAuthContext *context)
+{
+  if (context->resource)
+    epc_resource_unref (context->resource);
+
+  context->resource = NULL;
+}
+
+/* Clients are only challenged for batch requests when they have sent
+ * credentials, or have announced to have some. Other clients just don't
+ * receive the protected keys, instead of failing the entire request.
+ */
+static gboolean
+epc_publisher_batch_needs_auth (EpcPublisher *self,
+                                SoupMessage  *message)
+{
+  gboolean needs_auth = FALSE;
+  GPtrArray *keys;
+  guint i;
+
+  if (!soup_message_headers_get_one (message->request_headers, "Authorization") &&
+      !soup_message_headers_get_one (message->request_headers, "X-Epc-Authenticate"))
+    return FALSE;
+
+  keys = epc_publisher_get_batch_keys (self, message);
+
+  for (i = 0; i < keys->len && !needs_auth; ++i)
+    {
+      EpcResource *resource;
+
+      resource = epc_publisher_ref_resource (self, g_ptr_array_index (keys, i));
+
+      if (resource)
+        {
+          needs_auth = epc_resource_has_auth (resource);
+          epc_resource_unref (resource);
+        }
+    }
+
+  return needs_auth;
+}
+
+/* Batch requests cover many resources, so each protected key is checked
+ * separately. Keys granted are remembered for epc_publisher_handle_batch(),
+ * the others are omitted from the response instead of failing the request.
+ */
+static gboolean
+epc_publisher_authorize_batch (EpcPublisher *self,
+                               SoupMessage  *message,
+                               const gchar  *username,
+                               const gchar  *password)
+{
+  GHashTable *granted;
+  GPtrArray *keys;
+  guint i;
+
+  granted = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  keys = epc_publisher_get_batch_keys (self, message);
+
+  for (i = 0; i < keys->len; ++i)
+    {
+      const gchar *key = g_ptr_array_index (keys, i);
+      EpcResource *resource = epc_publisher_ref_resource (self, key);
+
+      if (resource && epc_resource_has_auth (resource))
+        {
+          EpcAuthContext context;
+
+          context.publisher = self;
+          context.resource = resource;
+          context.key = key;
+          context.message = message;
+          context.username = username;
+          context.password = password;
+
+          if (epc_publisher_call_auth_handler (&context, username))
+            g_hash_table_add (granted, g_strdup (key));
+
+          if (EPC_DEBUG_LEVEL (1))
+            g_debug ("%s: key=%s, authorized=%d", G_STRLOC, key,
+                     g_hash_table_contains (granted, key));
+        }
+
+      if (resource)
+        epc_resource_unref (resource);
+    }
+
+  g_object_set_data_full (G_OBJECT (message), "epc-batch-granted",
+                          granted, (GDestroyNotify) g_hash_table_unref);
+
+  return TRUE;
 }
 
 static gboolean
@@ -688,16 +2565,19 @@ epc_publisher_auth_filter (SoupAuthDomain *domain G_GNUC_UNUSED,
   gboolean authorized = TRUE;
   EpcAuthContext context;
 
-  g_rec_mutex_lock (&epc_publisher_lock);
+  if (epc_publisher_is_batch_request (message))
+    return epc_publisher_batch_needs_auth (EPC_PUBLISHER (data), message);
+
   epc_auth_context_init (&context, EPC_PUBLISHER (data), message, NULL, NULL);
-  authorized = (!context.resource || !context.resource->auth_handler);
+  authorized = (!context.resource || !epc_resource_has_auth (context.resource));
 
   if (EPC_DEBUG_LEVEL (1))
-    g_debug ("%s: key=%s, resource=%p, auth_handler=%p, authorized=%d", G_STRLOC,
-             context.key, context.resource, context.resource ? context.resource->auth_handler : NULL,
+    g_debug ("%s: key=%s, resource=%p, protected=%d, authorized=%d", G_STRLOC,
+             context.key, context.resource,
+             context.resource && epc_resource_has_auth (context.resource),
              authorized);
 
-  g_rec_mutex_unlock (&epc_publisher_lock);
+  epc_auth_context_clear (&context);
 
   return !authorized;
 }
@@ -712,18 +2592,21 @@ epc_publisher_basic_auth_cb (SoupAuthDomain *domain G_GNUC_UNUSED,
   gboolean authorized = TRUE;
   EpcAuthContext context;
 
-  g_rec_mutex_lock (&epc_publisher_lock);
+  if (epc_publisher_is_batch_request (message))
+    return epc_publisher_authorize_batch (EPC_PUBLISHER (data), message, username, password);
+
   epc_auth_context_init (&context, EPC_PUBLISHER (data), message, username, password);
 
-  if (context.resource && context.resource->auth_handler)
-    authorized = context.resource->auth_handler (&context, username, context.resource->auth_user_data);
+  if (context.resource && epc_resource_has_auth (context.resource))
+    authorized = epc_publisher_call_auth_handler (&context, username);
 
   if (EPC_DEBUG_LEVEL (1))
-    g_debug ("%s: key=%s, resource=%p, auth_handler=%p, authorized=%d", G_STRLOC,
-             context.key, context.resource, context.resource ? context.resource->auth_handler : NULL,
+    g_debug ("%s: key=%s, resource=%p, protected=%d, authorized=%d", G_STRLOC,
+             context.key, context.resource,
+             context.resource && epc_resource_has_auth (context.resource),
              authorized);
 
-  g_rec_mutex_unlock (&epc_publisher_lock);
+  epc_auth_context_clear (&context);
 
   return authorized;
 }
@@ -737,18 +2620,21 @@ epc_publisher_generic_auth_cb (SoupAuthDomain *domain G_GNUC_UNUSED,
   gboolean authorized = TRUE;
   EpcAuthContext context;
 
-  g_rec_mutex_lock (&epc_publisher_lock);
+  if (epc_publisher_is_batch_request (message))
+    return epc_publisher_authorize_batch (EPC_PUBLISHER (data), message, username, NULL);
+
   epc_auth_context_init (&context, EPC_PUBLISHER (data), message, username, NULL);
 
-  if (context.resource && context.resource->auth_handler)
-    authorized = context.resource->auth_handler (&context, username, context.resource->auth_user_data);
+  if (context.resource && epc_resource_has_auth (context.resource))
+    authorized = epc_publisher_call_auth_handler (&context, username);
 
   if (EPC_DEBUG_LEVEL (1))
-    g_debug ("%s: key=%s, resource=%p, auth_handler=%p, authorized=%d", G_STRLOC,
-             context.key, context.resource, context.resource ? context.resource->auth_handler : NULL,
+    g_debug ("%s: key=%s, resource=%p, protected=%d, authorized=%d", G_STRLOC,
+             context.key, context.resource,
+             context.resource && epc_resource_has_auth (context.resource),
              authorized);
 
-  g_rec_mutex_unlock (&epc_publisher_lock);
+  epc_auth_context_clear (&context);
 
   return authorized;
 }
@@ -760,7 +2646,8 @@ epc_publisher_init (EpcPublisher *self)
   self->priv->protocol = EPC_PROTOCOL_HTTPS;
 
   self->priv->resources = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                                 g_free, epc_resource_free);
+                                                 g_free, epc_resource_unref);
+  self->priv->resource_index = g_sequence_new (g_free);
   self->priv->clients = g_hash_table_new_full (g_direct_hash, g_direct_equal,
                                                g_object_unref, NULL);
 }
@@ -793,6 +2680,13 @@ epc_publisher_get_host (EpcPublisher     *self)
   GInetAddress *ad = g_inet_socket_address_get_address (inet);
   g_return_val_if_fail (ad, NULL);
 
+  /* The wildcard address isn't a host name, use the local host name. */
+  if (g_inet_address_get_is_any (ad))
+    {
+      g_object_unref (address);
+      return NULL;
+    }
+
   return g_inet_address_to_string (ad);
 }
 
@@ -819,8 +2713,16 @@ static GSocketFamily
 epc_publisher_get_family (EpcPublisher *self)
 {
   GSocket *listener = get_listener (self);
+  gint v6only = TRUE;
+
   g_return_val_if_fail (listener, 0);
 
+  /* Dual-stack sockets accept both address families. */
+  if (G_SOCKET_FAMILY_IPV6 == g_socket_get_family (listener) &&
+      g_socket_get_option (listener, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, NULL) &&
+      !v6only)
+    return G_SOCKET_FAMILY_INVALID;
+
   return g_socket_get_family (listener);
 }
 
@@ -1007,29 +2909,124 @@ epc_publisher_compute_name (EpcPublisher *self)
 }
 
 static void
-epc_publisher_remove_handlers (EpcPublisher *self)
+epc_publisher_remove_server_handlers (SoupServer     *server,
+                                      SoupAuthDomain *server_auth,
+                                      const gchar    *contents_path)
 {
-  if (self->priv->server_auth)
-    {
-      soup_server_remove_auth_domain (self->priv->server, self->priv->server_auth);
-      self->priv->server_auth = NULL;
-    }
+  if (server_auth)
+    soup_server_remove_auth_domain (server, server_auth);
 
-  if (self->priv->server)
-    {
-      soup_server_remove_handler (self->priv->server, self->priv->contents_path);
-      soup_server_remove_handler (self->priv->server, "/list");
-      soup_server_remove_handler (self->priv->server, "/");
-    }
+  soup_server_remove_handler (server, contents_path);
+  soup_server_remove_handler (server, "/list");
+  soup_server_remove_handler (server, "/batch");
+  soup_server_remove_handler (server, "/");
 }
 
 static void
 epc_publisher_add_server_callback (EpcPublisher       *self,
+                                   SoupServer         *server,
                                    const gchar        *path,
                                    SoupServerCallback  callback)
 {
-  soup_server_add_handler (self->priv->server, path,
-                           callback, self, NULL);
+  soup_server_add_handler (server, path, callback, self, NULL);
+}
+
+static void
+epc_publisher_add_server_handlers (EpcPublisher   *self,
+                                   SoupServer     *server,
+                                   SoupAuthDomain *server_auth,
+                                   const gchar    *contents_path)
+{
+  if (server_auth)
+    soup_server_add_auth_domain (server, server_auth);
+
+  epc_publisher_add_server_callback (self, server, contents_path, epc_publisher_handle_contents);
+  epc_publisher_add_server_callback (self, server, "/list", epc_publisher_handle_list);
+  epc_publisher_add_server_callback (self, server, "/batch", epc_publisher_handle_batch);
+  epc_publisher_add_server_callback (self, server, "/", epc_publisher_handle_root);
+}
+
+static void
+epc_listener_set_handlers (EpcListener    *listener,
+                           SoupAuthDomain *server_auth,
+                           const gchar    *contents_path)
+{
+  if (listener->contents_path)
+    epc_publisher_remove_server_handlers (listener->server,
+                                          listener->server_auth,
+                                          listener->contents_path);
+
+  if (listener->server_auth)
+    g_object_unref (listener->server_auth);
+
+  g_free (listener->contents_path);
+
+  listener->server_auth = server_auth ? g_object_ref (server_auth) : NULL;
+  listener->contents_path = g_strdup (contents_path);
+
+  epc_publisher_add_server_handlers (listener->publisher, listener->server,
+                                     listener->server_auth, listener->contents_path);
+}
+
+static gboolean
+epc_listener_update_cb (gpointer data)
+{
+  EpcListenerUpdate *update = data;
+
+  epc_listener_set_handlers (update->listener,
+                             update->server_auth,
+                             update->contents_path);
+
+  return FALSE;
+}
+
+static void
+epc_listener_update_free (gpointer data)
+{
+  EpcListenerUpdate *update = data;
+
+  if (update->server_auth)
+    g_object_unref (update->server_auth);
+
+  g_free (update->contents_path);
+  g_slice_free (EpcListenerUpdate, update);
+}
+
+/* Listeners replace their handlers from their own thread, as SoupServer
+ * doesn't support changing handlers while it dispatches requests.
+ */
+static void
+epc_publisher_update_listeners (EpcPublisher *self)
+{
+  GSList *iter;
+
+  for (iter = self->priv->listeners; iter; iter = iter->next)
+    {
+      EpcListenerUpdate *update = g_slice_new0 (EpcListenerUpdate);
+
+      update->listener = iter->data;
+      update->contents_path = g_strdup (self->priv->contents_path);
+
+      if (self->priv->server_auth)
+        update->server_auth = g_object_ref (self->priv->server_auth);
+
+      g_main_context_invoke_full (update->listener->context, G_PRIORITY_DEFAULT,
+                                  epc_listener_update_cb, update,
+                                  epc_listener_update_free);
+    }
+}
+
+static void
+epc_publisher_remove_handlers (EpcPublisher *self)
+{
+  if (self->priv->server)
+    epc_publisher_remove_server_handlers (self->priv->server,
+                                          self->priv->server_auth,
+                                          self->priv->contents_path);
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+  self->priv->server_auth = NULL;
+  g_rec_mutex_unlock (&epc_publisher_lock);
 }
 
 static void
@@ -1037,6 +3034,8 @@ epc_publisher_install_handlers (EpcPublisher *self)
 {
   g_assert (NULL == self->priv->server_auth);
 
+  g_rec_mutex_lock (&epc_publisher_lock);
+
   if (self->priv->auth_flags & EPC_AUTH_PASSWORD_TEXT_NEEDED)
     {
       self->priv->server_auth =
@@ -1067,14 +3066,17 @@ epc_publisher_install_handlers (EpcPublisher *self)
       }
     }
 
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
   soup_auth_domain_set_filter (self->priv->server_auth, epc_publisher_auth_filter, self, NULL);
   soup_auth_domain_add_path (self->priv->server_auth, self->priv->contents_path);
+  soup_auth_domain_add_path (self->priv->server_auth, "/batch");
 
-  soup_server_add_auth_domain (self->priv->server, self->priv->server_auth);
+  epc_publisher_add_server_handlers (self, self->priv->server,
+                                     self->priv->server_auth,
+                                     self->priv->contents_path);
 
-  epc_publisher_add_server_callback (self, self->priv->contents_path, epc_publisher_handle_contents);
-  epc_publisher_add_server_callback (self, "/list", epc_publisher_handle_list);
-  epc_publisher_add_server_callback (self, "/", epc_publisher_handle_root);
+  epc_publisher_update_listeners (self);
 }
 
 static void
@@ -1084,7 +3086,9 @@ epc_publisher_client_disconnected_cb (EpcPublisher *self,
   if (EPC_DEBUG_LEVEL (1))
     epc_publisher_trace_client (G_STRFUNC, "disconnected", socket);
 
+  g_rec_mutex_lock (&epc_publisher_lock);
   g_hash_table_remove (self->priv->clients, socket);
+  g_rec_mutex_unlock (&epc_publisher_lock);
 }
 
 static void
@@ -1094,12 +3098,421 @@ epc_publisher_new_connection_cb (EpcPublisher *self,
   if (EPC_DEBUG_LEVEL (1))
     epc_publisher_trace_client (G_STRFUNC, "new client", socket);
 
+  g_rec_mutex_lock (&epc_publisher_lock);
   g_object_ref (socket);
   g_hash_table_replace (self->priv->clients, socket, GINT_TO_POINTER (1));
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  g_signal_connect_swapped (socket, "disconnected",
+                            G_CALLBACK (epc_publisher_client_disconnected_cb),
+                            self);
+}
+
+/* Servers listening on shared sockets don't announce new connections,
+ * so their clients are tracked when sending their first request.
+ */
+static void
+epc_publisher_request_started_cb (SoupServer        *server G_GNUC_UNUSED,
+                                  SoupMessage       *message G_GNUC_UNUSED,
+                                  SoupClientContext *context,
+                                  gpointer           data)
+{
+  GSocket *socket = soup_client_context_get_gsocket (context);
+  EpcPublisher *self = data;
+
+  if (!socket)
+    return;
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  if (!g_hash_table_contains (self->priv->clients, socket))
+    {
+      GHashTableIter iter;
+      gpointer key, value;
+
+      /* Forget idle clients which have disconnected meanwhile. */
+      g_hash_table_iter_init (&iter, self->priv->clients);
+
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        if (GPOINTER_TO_INT (value) <= 1 && g_socket_is_closed (key))
+          g_hash_table_iter_remove (&iter);
+
+      if (EPC_DEBUG_LEVEL (1))
+        epc_publisher_trace_client (G_STRFUNC, "new client", socket);
+
+      g_hash_table_replace (self->priv->clients, g_object_ref (socket), GINT_TO_POINTER (1));
+    }
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+}
+
+/* Creates a listening socket for @family, which can share @port with
+ * the sockets of other listeners. IPv6 sockets also accept IPv4 clients.
+ */
+static GSocket*
+epc_publisher_create_socket (GSocketFamily   family,
+                             guint16         port,
+                             GError        **error)
+{
+#ifdef SO_REUSEPORT
+  GSocketAddress *address;
+  GInetAddress *any;
+  GSocket *socket;
+  gboolean success;
+
+  socket = g_socket_new (family, G_SOCKET_TYPE_STREAM,
+                         G_SOCKET_PROTOCOL_TCP, error);
+
+  if (!socket)
+    return NULL;
+
+  any = g_inet_address_new_any (family);
+  address = g_inet_socket_address_new (any, port);
+
+  success =
+    (G_SOCKET_FAMILY_IPV6 != family ||
+     g_socket_set_option (socket, IPPROTO_IPV6, IPV6_V6ONLY, FALSE, error)) &&
+    g_socket_set_option (socket, SOL_SOCKET, SO_REUSEPORT, TRUE, error) &&
+    g_socket_bind (socket, address, TRUE, error) &&
+    g_socket_listen (socket, error);
+
+  g_object_unref (address);
+  g_object_unref (any);
+
+  if (!success)
+    {
+      g_object_unref (socket);
+      socket = NULL;
+    }
+
+  return socket;
+#else
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+               _("Sharing ports between sockets is not supported"));
+  return NULL;
+#endif
+}
+
+/* Creates a server listening on a SO_REUSEPORT socket bound to @port.
+ * Requests are dispatched from the thread-default main context. Passing
+ * %G_SOCKET_FAMILY_INVALID for @family prefers a dual-stack IPv6 socket,
+ * and falls back to IPv4 on hosts without IPv6 support.
+ */
+static SoupServer*
+epc_publisher_create_shared_server (GTlsCertificate  *certificate,
+                                    GSocketFamily     family,
+                                    guint16           port,
+                                    GError          **error)
+{
+  SoupServerListenOptions options = 0;
+  SoupServer *server;
+  GSocket *socket;
+
+  if (G_SOCKET_FAMILY_INVALID == family)
+    {
+      socket = epc_publisher_create_socket (G_SOCKET_FAMILY_IPV6, port, NULL);
+
+      if (!socket)
+        socket = epc_publisher_create_socket (G_SOCKET_FAMILY_IPV4, port, error);
+    }
+  else
+    socket = epc_publisher_create_socket (family, port, error);
+
+  if (!socket)
+    return NULL;
+
+  if (certificate)
+    options |= SOUP_SERVER_LISTEN_HTTPS;
+
+  server = soup_server_new (SOUP_SERVER_TLS_CERTIFICATE, certificate, NULL);
+
+  if (!soup_server_listen_socket (server, socket, options, error))
+    {
+      g_object_unref (server);
+      server = NULL;
+    }
+
+  g_object_unref (socket);
+
+  return server;
+}
+
+static void
+epc_listener_destroy (EpcListener *listener)
+{
+  if (listener->server)
+    g_object_unref (listener->server);
+  if (listener->server_auth)
+    g_object_unref (listener->server_auth);
+
+  g_free (listener->contents_path);
+  g_main_loop_unref (listener->loop);
+  g_main_context_unref (listener->context);
+  g_slice_free (EpcListener, listener);
+}
+
+/* Fails the requests still waiting for their handler, as nobody would
+ * deliver their contents once the listener's main loop has stopped.
+ * Their handlers still must call epc_contents_request_complete(),
+ * which then just releases the request.
+ */
+static void
+epc_listener_abandon_requests (EpcListener *listener)
+{
+  GList *pending, *iter;
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  pending = listener->requests;
+  listener->requests = NULL;
+
+  for (iter = pending; iter; iter = iter->next)
+    {
+      EpcContentsRequest *request = iter->data;
+
+      /* Completed requests are delivered when draining the context. */
+      if (request->completed)
+        {
+          listener->requests = g_list_prepend (listener->requests, request);
+          continue;
+        }
+
+      request->abandoned = TRUE;
+      request->listener = NULL;
+
+      if (!request->finished)
+        {
+          soup_message_set_status (request->message, SOUP_STATUS_SERVICE_UNAVAILABLE);
+          soup_server_unpause_message (request->server, request->message);
+        }
+    }
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  g_list_free (pending);
+}
+
+static gpointer
+epc_listener_thread (gpointer data)
+{
+  EpcListener *listener = data;
+
+  g_main_context_push_thread_default (listener->context);
+  g_main_loop_run (listener->loop);
+
+  /* Deliver requests completed before the listener was stopped,
+   * then fail those which arrived meanwhile. */
+  while (g_main_context_iteration (listener->context, FALSE));
+
+  soup_server_disconnect (listener->server);
+  epc_listener_abandon_requests (listener);
+
+  while (g_main_context_iteration (listener->context, FALSE));
+
+  g_main_context_pop_thread_default (listener->context);
+
+  /* Listeners stopped from their own thread release themselves. */
+  if (listener->detached)
+    epc_listener_destroy (listener);
+
+  return NULL;
+}
+
+static gboolean
+epc_listener_quit_cb (gpointer data)
+{
+  EpcListener *listener = data;
+
+  epc_listener_abandon_requests (listener);
+  g_main_loop_quit (listener->loop);
+
+  return FALSE;
+}
+
+static void
+epc_listener_free (EpcListener *listener)
+{
+  if (listener->thread == g_thread_self ())
+    {
+      /* Joining the calling thread would deadlock. Instead the
+       * listener is released when its main loop has returned. */
+      epc_listener_abandon_requests (listener);
+      g_main_loop_quit (listener->loop);
+
+      g_thread_unref (listener->thread);
+      listener->detached = TRUE;
+      return;
+    }
+
+  if (listener->thread)
+    {
+      GSource *source = g_idle_source_new ();
+
+      /* Quitting from the listener's context, as the loop
+       * might not be running yet. */
+      g_source_set_callback (source, epc_listener_quit_cb, listener, NULL);
+      g_source_attach (source, listener->context);
+      g_source_unref (source);
+
+      g_thread_join (listener->thread);
+    }
+
+  epc_listener_destroy (listener);
+}
+
+static EpcListener*
+epc_listener_new (EpcPublisher     *self,
+                  GTlsCertificate  *certificate,
+                  GSocketFamily     family,
+                  guint16           port,
+                  GError          **error)
+{
+  EpcListener *listener = g_slice_new0 (EpcListener);
+
+  listener->publisher = self;
+  listener->context = g_main_context_new ();
+  listener->loop = g_main_loop_new (listener->context, FALSE);
+
+  g_main_context_push_thread_default (listener->context);
+  listener->server = epc_publisher_create_shared_server (certificate, family, port, error);
+  g_main_context_pop_thread_default (listener->context);
+
+  if (!listener->server)
+    {
+      epc_listener_free (listener);
+      return NULL;
+    }
+
+  g_signal_connect (listener->server, "request-started",
+                    G_CALLBACK (epc_publisher_request_started_cb), self);
+
+  epc_listener_set_handlers (listener,
+                             self->priv->server_auth,
+                             self->priv->contents_path);
+
+  listener->thread = g_thread_new ("epc-listener", epc_listener_thread, listener);
+
+  return listener;
+}
+
+static gint
+epc_publisher_count_listeners (EpcPublisher *self)
+{
+  if (self->priv->listener_threads < 0)
+    return g_get_num_processors () - 1;
+
+  return self->priv->listener_threads;
+}
+
+static void
+epc_publisher_set_listeners_stopping (EpcPublisher *self,
+                                      gboolean      stopping)
+{
+  g_mutex_lock (&epc_server_call_mutex);
+  self->priv->listeners_stopping = stopping;
+  g_cond_broadcast (&epc_server_call_cond);
+  g_mutex_unlock (&epc_server_call_mutex);
+}
+
+static void
+epc_publisher_stop_listeners (EpcPublisher *self)
+{
+  GSList *listeners;
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+  listeners = self->priv->listeners;
+  self->priv->listeners = NULL;
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  if (!listeners)
+    return;
+
+  /* Listeners waiting for this thread to run one of their
+   * handlers must give up, before they can be joined. */
+  epc_publisher_set_listeners_stopping (self, TRUE);
+
+  /* The lock must not be held while joining, as
+   * the listener threads acquire it themselves. */
+  g_slist_foreach (listeners, (GFunc) epc_listener_free, NULL);
+  g_slist_free (listeners);
+
+  epc_publisher_set_listeners_stopping (self, FALSE);
+}
+
+static gboolean
+epc_publisher_start_listeners (EpcPublisher  *self,
+                               GError       **error)
+{
+  GTlsCertificate *certificate = NULL;
+  GSocketFamily family;
+  gint n_listeners, i;
+  guint16 port;
+
+  n_listeners = epc_publisher_count_listeners (self);
+
+  if (EPC_PROTOCOL_HTTPS == self->priv->protocol)
+    {
+      certificate = g_tls_certificate_new_from_files (self->priv->certificate_file,
+                                                      self->priv->private_key_file,
+                                                      error);
+
+      if (!certificate)
+        return FALSE;
+    }
+
+  self->priv->server = epc_publisher_create_shared_server (certificate,
+                                                           G_SOCKET_FAMILY_INVALID,
+                                                           SOUP_ADDRESS_ANY_PORT,
+                                                           error);
+
+  if (!self->priv->server)
+    {
+      if (certificate)
+        g_object_unref (certificate);
+
+      return FALSE;
+    }
+
+  g_signal_connect (self->priv->server, "request-started",
+                    G_CALLBACK (epc_publisher_request_started_cb), self);
+
+  epc_publisher_install_handlers (self);
+  port = epc_publisher_get_port (self);
+
+  /* The port only is shared by sockets of the same family. */
+  family = g_socket_get_family (get_listener (self));
+
+  for (i = 0; i < n_listeners; ++i)
+    {
+      EpcListener *listener = epc_listener_new (self, certificate, family, port, error);
+
+      if (!listener)
+        break;
+
+      g_rec_mutex_lock (&epc_publisher_lock);
+      self->priv->listeners = g_slist_prepend (self->priv->listeners, listener);
+      g_rec_mutex_unlock (&epc_publisher_lock);
+    }
+
+  if (certificate)
+    g_object_unref (certificate);
+
+  if (i < n_listeners)
+    {
+      epc_publisher_stop_listeners (self);
+      epc_publisher_remove_handlers (self);
+
+      g_object_unref (self->priv->server);
+      self->priv->server = NULL;
+
+      return FALSE;
+    }
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: %d listener threads sharing port %d",
+             G_STRLOC, n_listeners, port);
 
-  g_signal_connect_swapped (socket, "disconnected",
-                            G_CALLBACK (epc_publisher_client_disconnected_cb),
-                            self);
+  return TRUE;
 }
 
 static gboolean
@@ -1149,17 +3562,33 @@ epc_publisher_create_server (EpcPublisher  *self,
         }
     }
 
-  self->priv->server =
-    soup_server_new (SOUP_SERVER_SSL_CERT_FILE, self->priv->certificate_file,
-                     SOUP_SERVER_SSL_KEY_FILE, self->priv->private_key_file,
-                     SOUP_SERVER_PORT, SOUP_ADDRESS_ANY_PORT,
-                     NULL);
+  /* Serve requests from the calling thread's main context. This allows
+   * running multiple publishers in separate threads, each with its own
+   * main loop, without contending for a single dispatching thread.
+   */
+  self->priv->server_context = g_main_context_ref_thread_default ();
 
-  /* TODO */
-  g_signal_connect_swapped (get_listener (self), "new-connection",
-                            G_CALLBACK (epc_publisher_new_connection_cb), self);
+  if (epc_publisher_count_listeners (self) > 0)
+    {
+      if (!epc_publisher_start_listeners (self, error))
+        return FALSE;
+    }
+  else
+    {
+      self->priv->server =
+        soup_server_new (SOUP_SERVER_SSL_CERT_FILE, self->priv->certificate_file,
+                         SOUP_SERVER_SSL_KEY_FILE, self->priv->private_key_file,
+                         SOUP_SERVER_PORT, SOUP_ADDRESS_ANY_PORT,
+                         SOUP_SERVER_ASYNC_CONTEXT, self->priv->server_context,
+                         NULL);
+
+      /* TODO */
+      g_signal_connect_swapped (get_listener (self), "new-connection",
+                                G_CALLBACK (epc_publisher_new_connection_cb), self);
+
+      epc_publisher_install_handlers (self);
+    }
 
-  epc_publisher_install_handlers (self);
   epc_publisher_announce (self);
 
   base_uri = epc_publisher_get_uri (self, NULL, NULL);
@@ -1176,8 +3605,10 @@ epc_publisher_real_set_service_name (EpcPublisher *self,
   if (self->priv->server)
     epc_publisher_remove_handlers (self);
 
+  g_rec_mutex_lock (&epc_publisher_lock);
   g_free (self->priv->service_name);
   self->priv->service_name = g_value_dup_string (value);
+  g_rec_mutex_unlock (&epc_publisher_lock);
 
   if (self->priv->server)
     epc_publisher_install_handlers (self);
@@ -1211,6 +3642,40 @@ epc_publisher_real_set_auth_flags (EpcPublisher *self,
     epc_publisher_install_handlers (self);
 }
 
+static void
+epc_publisher_real_set_handler_threads (EpcPublisher *self,
+                                        const GValue *value)
+{
+  GThreadPool *obsolete = NULL;
+  gint max_threads;
+
+  self->priv->handler_threads = g_value_get_int (value);
+  max_threads = self->priv->handler_threads;
+
+  if (max_threads < 0)
+    max_threads = g_get_num_processors ();
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  if (0 == max_threads)
+    {
+      obsolete = self->priv->handler_pool;
+      self->priv->handler_pool = NULL;
+    }
+  else if (self->priv->handler_pool)
+    g_thread_pool_set_max_threads (self->priv->handler_pool, max_threads, NULL);
+  else
+    self->priv->handler_pool = g_thread_pool_new (epc_publisher_run_handler,
+                                                  NULL, max_threads,
+                                                  FALSE, NULL);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  /* Jobs already queued still get processed. */
+  if (obsolete)
+    g_thread_pool_free (obsolete, FALSE, FALSE);
+}
+
 /**
  * epc_publisher_set_service_cookie:
  * @publisher: a #EpcPublisher
@@ -1263,8 +3728,10 @@ epc_publisher_real_set_contents_path (EpcPublisher *self,
       if (self->priv->server)
         epc_publisher_remove_handlers (self);
 
+      g_rec_mutex_lock (&epc_publisher_lock);
       g_free (self->priv->contents_path);
       self->priv->contents_path = g_value_dup_string (value);
+      g_rec_mutex_unlock (&epc_publisher_lock);
 
       if (self->priv->server)
         epc_publisher_install_handlers (self);
@@ -1345,6 +3812,15 @@ epc_publisher_set_property (GObject      *object,
         self->priv->private_key_file = g_value_dup_string (value);
         break;
 
+      case PROP_HANDLER_THREADS:
+        epc_publisher_real_set_handler_threads (self, value);
+        break;
+
+      case PROP_LISTENER_THREADS:
+        g_return_if_fail (!epc_publisher_is_server_created (self));
+        self->priv->listener_threads = g_value_get_int (value);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -1401,6 +3877,14 @@ epc_publisher_get_property (GObject    *object,
         g_value_set_string (value, self->priv->private_key_file);
         break;
 
+      case PROP_HANDLER_THREADS:
+        g_value_set_int (value, self->priv->handler_threads);
+        break;
+
+      case PROP_LISTENER_THREADS:
+        g_value_set_int (value, self->priv->listener_threads);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -1411,6 +3895,7 @@ static void
 epc_publisher_dispose (GObject *object)
 {
   EpcPublisher *self = EPC_PUBLISHER (object);
+  guint i;
 
   epc_publisher_quit (self);
 
@@ -1426,12 +3911,33 @@ epc_publisher_dispose (GObject *object)
       self->priv->resources = NULL;
     }
 
+  if (self->priv->resource_index)
+    {
+      g_sequence_free (self->priv->resource_index);
+      self->priv->resource_index = NULL;
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (self->priv->listings); ++i)
+    if (self->priv->listings[i])
+      {
+        epc_contents_unref (self->priv->listings[i]);
+        self->priv->listings[i] = NULL;
+      }
+
   if (self->priv->default_resource)
     {
-      epc_resource_free (self->priv->default_resource);
+      epc_resource_unref (self->priv->default_resource);
       self->priv->default_resource = NULL;
     }
 
+  /* Pending jobs hold a reference on the publisher,
+   * so the pool is idle at this point. */
+  if (self->priv->handler_pool)
+    {
+      g_thread_pool_free (self->priv->handler_pool, FALSE, TRUE);
+      self->priv->handler_pool = NULL;
+    }
+
   g_free (self->priv->certificate_file);
   self->priv->certificate_file = NULL;
 
@@ -1567,6 +4073,55 @@ epc_publisher_class_init (EpcPublisherClass *cls)
                                                         G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
                                                         G_PARAM_STATIC_BLURB));
 
+  /**
+   * EpcPublisher:handler-threads:
+   *
+   * The maximum number of threads running contents handlers flagged with
+   * #EPC_HANDLER_THREAD_SAFE. Zero runs all handlers in the server's main
+   * context, and -1 uses as many threads as processors are available.
+   *
+   * Since: 1.10
+   */
+  g_object_class_install_property (oclass, PROP_HANDLER_THREADS,
+                                   g_param_spec_int ("handler-threads", "Handler Threads",
+                                                     "The maximum number of threads running thread-safe contents handlers",
+                                                     -1, G_MAXINT, 0,
+                                                     G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                                                     G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
+                                                     G_PARAM_STATIC_BLURB));
+
+  /**
+   * EpcPublisher:listener-threads:
+   *
+   * The number of additional threads accepting connections for this
+   * publisher. Each of those threads runs its own server instance in its
+   * own main context. All instances share the publisher's port through
+   * the <literal>SO_REUSEPORT</literal> socket option, so the kernel
+   * distributes incoming connections and their TLS handshakes among them.
+   * All instances serve the same resources.
+   *
+   * Listener threads only call contents handlers and authentication
+   * handlers flagged with #EPC_HANDLER_THREAD_SAFE directly. All other
+   * handlers are still called from the main context of the thread which
+   * started the publisher, so that context must keep running. Requests
+   * still waiting for epc_contents_request_complete() when the listeners
+   * are stopped get answered with <literal>503 Service Unavailable</literal>.
+   *
+   * Zero serves all requests from the main context of the thread which
+   * started the publisher, and -1 starts one additional thread for each
+   * processor but the first. This property must be set before
+   * starting the publisher.
+   *
+   * Since: 1.10
+   */
+  g_object_class_install_property (oclass, PROP_LISTENER_THREADS,
+                                   g_param_spec_int ("listener-threads", "Listener Threads",
+                                                     "The number of additional threads accepting connections",
+                                                     -1, G_MAXINT, 0,
+                                                     G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                                                     G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
+                                                     G_PARAM_STATIC_BLURB));
+
   g_type_class_add_private (cls, sizeof (EpcPublisherPrivate));
   g_rec_mutex_init (&epc_publisher_lock);
 }
@@ -1652,11 +4207,45 @@ epc_publisher_add (EpcPublisher  *self,
  * Publishes a local file on the #EpcPublisher using the unique
  * @key for addressing. The publisher delivers the current contents
  * of the file at the time of access.
+ *
+ * Large files are memory mapped instead of being read into memory, and the
+ * mapping is shared by all clients as long as the file's modification
+ * time and size don't change.
+ *
+ * <note><para>
+ *  Don't truncate large published files in place, as accessing the pages
+ *  of a mapping beyond the new end of the file raises <literal>SIGBUS</literal>. Write the
+ *  new contents to a temporary file and rename it instead, like
+ *  g_file_set_contents() does.
+ * </para></note>
  */
 void
 epc_publisher_add_file (EpcPublisher  *self,
                         const gchar   *key,
                         const gchar   *filename)
+{
+  epc_publisher_add_file_full (self, key, filename, NULL);
+}
+
+/**
+ * epc_publisher_add_file_full:
+ * @publisher: a #EpcPublisher
+ * @key: the key for addressing the file
+ * @filename: the name of the file to publish
+ * @mime_type: the MIME type of the file, or %NULL
+ *
+ * Publishes a local file on the #EpcPublisher like epc_publisher_add_file()
+ * does, but allows to declare the MIME type of the file. When %NULL is passed
+ * for @mime_type the type is guessed from the file name and its first bytes.
+ * The guessed type is cached until the file gets modified or replaced.
+ *
+ * Since: 1.10
+ */
+void
+epc_publisher_add_file_full (EpcPublisher  *self,
+                             const gchar   *key,
+                             const gchar   *filename,
+                             const gchar   *mime_type)
 {
   g_return_if_fail (EPC_IS_PUBLISHER (self));
   g_return_if_fail (NULL != filename);
@@ -1664,7 +4253,38 @@ epc_publisher_add_file (EpcPublisher  *self,
 
   epc_publisher_add_handler (self, key,
                              epc_publisher_handle_file,
-                             g_strdup (filename), g_free);
+                             epc_file_resource_new (filename, mime_type),
+                             epc_file_resource_free);
+
+  /* File resources protect their state by a mutex. */
+  epc_publisher_set_handler_flags (self, key, EPC_HANDLER_THREAD_SAFE);
+}
+
+/* Inserts @resource for @key, replacing any previous resource.
+ * Ownership of @resource is transferred to the publisher.
+ */
+static void
+epc_publisher_add_resource (EpcPublisher *self,
+                            const gchar  *key,
+                            EpcResource  *resource)
+{
+  gchar *markup;
+
+  /* Escape the key once, instead of on each listing request. */
+  markup = g_markup_escape_text (key, -1);
+  resource->markup = g_strconcat ("<item><name>", markup, "</name></item>", NULL);
+  g_free (markup);
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  if (!g_hash_table_contains (self->priv->resources, key))
+    g_sequence_insert_sorted (self->priv->resource_index, g_strdup (key),
+                              epc_publisher_compare_keys, NULL);
+
+  g_hash_table_insert (self->priv->resources, g_strdup (key), resource);
+  self->priv->resources_generation += 1;
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
 }
 
 /**
@@ -1691,6 +4311,49 @@ epc_publisher_add_handler (EpcPublisher      *self,
                            EpcContentsHandler handler,
                            gpointer           user_data,
                            GDestroyNotify     destroy_data)
+{
+  g_return_if_fail (EPC_IS_PUBLISHER (self));
+  g_return_if_fail (NULL != handler);
+  g_return_if_fail (NULL != key);
+
+  epc_publisher_add_resource (self, key, epc_resource_new (handler, user_data, destroy_data));
+}
+
+/**
+ * epc_publisher_add_async_handler:
+ * @publisher: a #EpcPublisher
+ * @key: the key for addressing the contents
+ * @handler: the #EpcAsyncContentsHandler for handling this contents
+ * @user_data: data to pass on @handler calls
+ * @destroy_data: a function for releasing @user_data
+ *
+ * Publishes contents on the #EpcPublisher which are generated by a custom
+ * #EpcAsyncContentsHandler callback. Other than the handlers installed by
+ * epc_publisher_add_handler() this handler doesn't have to provide the
+ * contents immediately. Instead it receives an #EpcContentsRequest, which
+ * is finished by calling epc_contents_request_complete() from any thread
+ * as soon as the contents are available. The publisher serves other
+ * requests meanwhile, so slow handlers, like handlers waiting for database
+ * queries, don't block each other.
+ *
+ * Like other handlers @handler is called from the main context of the
+ * publisher, unless it was flagged with %EPC_HANDLER_THREAD_SAFE by
+ * epc_publisher_set_handler_flags(). The response is sent from the
+ * context of the server which received the request.
+ *
+ * Keys published with an asynchronous handler are not included in the
+ * responses to epc_consumer_lookup_many().
+ *
+ * See epc_publisher_add_handler() for a description of the other arguments.
+ *
+ * Since: 1.10
+ */
+void
+epc_publisher_add_async_handler (EpcPublisher            *self,
+                                 const gchar             *key,
+                                 EpcAsyncContentsHandler  handler,
+                                 gpointer                 user_data,
+                                 GDestroyNotify           destroy_data)
 {
   EpcResource *resource;
 
@@ -1698,12 +4361,92 @@ epc_publisher_add_handler (EpcPublisher      *self,
   g_return_if_fail (NULL != handler);
   g_return_if_fail (NULL != key);
 
+  resource = epc_resource_new (NULL, user_data, destroy_data);
+  resource->async_handler = handler;
+
+  epc_publisher_add_resource (self, key, resource);
+}
+
+/**
+ * epc_contents_request_get_publisher:
+ * @request: a #EpcContentsRequest
+ *
+ * Queries the #EpcPublisher which received @request.
+ *
+ * Returns: The #EpcPublisher which received @request.
+ *
+ * Since: 1.10
+ */
+EpcPublisher*
+epc_contents_request_get_publisher (const EpcContentsRequest *request)
+{
+  g_return_val_if_fail (NULL != request, NULL);
+  return request->publisher;
+}
+
+/**
+ * epc_contents_request_get_key:
+ * @request: a #EpcContentsRequest
+ *
+ * Queries the key of the resource requested by @request.
+ *
+ * Returns: The key of the requested resource.
+ *
+ * Since: 1.10
+ */
+const gchar*
+epc_contents_request_get_key (const EpcContentsRequest *request)
+{
+  g_return_val_if_fail (NULL != request, NULL);
+  return request->key;
+}
+
+/**
+ * epc_contents_request_complete:
+ * @request: a #EpcContentsRequest
+ * @contents: the #EpcContents buffer for this request, or %NULL
+ *
+ * Finishes a request received by an #EpcAsyncContentsHandler. The
+ * #EpcPublisher takes ownership of @contents, and sends it from the
+ * main context of its server. Passing %NULL as @contents makes the
+ * publisher behave as if the key would not exist.
+ *
+ * This function can be called from any thread, and must be called
+ * exactly once for each request. The @request is released by this
+ * call and must not be used anymore. When the listener thread serving
+ * @request was stopped meanwhile, @contents is just released.
+ *
+ * Since: 1.10
+ */
+void
+epc_contents_request_complete (EpcContentsRequest *request,
+                               EpcContents        *contents)
+{
+  gboolean abandoned;
+
+  g_return_if_fail (NULL != request);
+  g_return_if_fail (!request->completed);
+
   g_rec_mutex_lock (&epc_publisher_lock);
 
-  resource = epc_resource_new (handler, user_data, destroy_data);
-  g_hash_table_insert (self->priv->resources, g_strdup (key), resource);
+  request->contents = contents;
+  request->completed = TRUE;
+  abandoned = request->abandoned;
+
+  if (!abandoned)
+    {
+      GSource *source = g_idle_source_new ();
+
+      g_source_set_callback (source, epc_contents_request_complete_cb, request, NULL);
+      g_source_attach (source, request->context);
+      g_source_unref (source);
+    }
 
   g_rec_mutex_unlock (&epc_publisher_lock);
+
+  /* The listener which received this request is gone already. */
+  if (abandoned)
+    epc_contents_request_free (request);
 }
 
 /**
@@ -1814,6 +4557,17 @@ epc_publisher_remove (EpcPublisher *self,
     }
 
   success = g_hash_table_remove (self->priv->resources, key);
+
+  if (success)
+    {
+      g_sequence_remove (g_sequence_lookup (self->priv->resource_index,
+                                            (gpointer) key,
+                                            epc_publisher_compare_keys,
+                                            NULL));
+
+      self->priv->resources_generation += 1;
+    }
+
   g_rec_mutex_unlock (&epc_publisher_lock);
 
   return success;
@@ -1890,13 +4644,10 @@ epc_publisher_has_key (EpcPublisher *self,
 
 static void
 epc_publisher_list_cb (gpointer key,
-                       gpointer value G_GNUC_UNUSED,
                        gpointer data)
 {
-  EpcListContext *context = data;
-
-  if (NULL == context->pattern || g_pattern_match_string (context->pattern, key))
-    context->matches = g_list_prepend (context->matches, g_strdup (key));
+  GList **matches = data;
+  *matches = g_list_prepend (*matches, g_strdup (key));
 }
 
 /**
@@ -1911,7 +4662,10 @@ epc_publisher_list_cb (gpointer key,
  * for information about glob-style patterns.
  *
  * If the call was successful, a list of keys matching @pattern is returned.
- * If the call was not successful, it returns %NULL.
+ * If the call was not successful, it returns %NULL. The keys are sorted
+ * by byte value. Matching is fast for patterns starting with a literal
+ * prefix, like "sensor-42-*", as only keys sharing this prefix
+ * are inspected.
  *
  * The returned list should be freed when no longer needed:
  *
@@ -1928,28 +4682,19 @@ GList*
 epc_publisher_list (EpcPublisher *self,
                     const gchar  *pattern)
 {
-  EpcListContext context;
+  GList *matches = NULL;
 
   g_return_val_if_fail (EPC_IS_PUBLISHER (self), NULL);
 
-  context.matches = NULL;
-  context.pattern = NULL;
-
-  if (pattern && *pattern)
-    context.pattern = g_pattern_spec_new (pattern);
-
   g_rec_mutex_lock (&epc_publisher_lock);
 
-  g_hash_table_foreach (self->priv->resources,
-                        epc_publisher_list_cb,
-                        &context);
+  epc_publisher_foreach_key (self, pattern, NULL, 0,
+                             epc_publisher_list_cb,
+                             &matches);
 
   g_rec_mutex_unlock (&epc_publisher_lock);
 
-  if (context.pattern)
-    g_pattern_spec_free (context.pattern);
-
-  return context.matches;
+  return g_list_reverse (matches);
 }
 
 /**
@@ -2001,6 +4746,83 @@ epc_publisher_set_auth_handler (EpcPublisher   *self,
   g_rec_mutex_unlock (&epc_publisher_lock);
 }
 
+/**
+ * epc_publisher_set_handler_flags:
+ * @publisher: a #EpcPublisher
+ * @key: the key of the resource to configure
+ * @flags: the new #EpcHandlerFlags
+ *
+ * Declares properties of the contents handler for @key. Handlers flagged
+ * with #EPC_HANDLER_THREAD_SAFE are run in a thread pool, when the
+ * #EpcPublisher:handler-threads property is not zero. This allows
+ * CPU-bound handlers to use all available processors.
+ *
+ * Handlers of files published by epc_publisher_add_file() are thread-safe.
+ *
+ * <note><para>
+ *  This should be called after adding the resource identified by @key,
+ *  not before. For instance, after calling epc_publisher_add_handler().
+ * </para></note>
+ *
+ * Since: 1.10
+ */
+void
+epc_publisher_set_handler_flags (EpcPublisher    *self,
+                                 const gchar     *key,
+                                 EpcHandlerFlags  flags)
+{
+  EpcResource *resource;
+
+  g_return_if_fail (EPC_IS_PUBLISHER (self));
+  g_return_if_fail (NULL != key);
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  resource = epc_publisher_find_resource (self, key);
+
+  if (resource)
+    g_atomic_int_set (&resource->flags, flags);
+  else
+    g_warning ("%s: No resource handler found for key `%s'", G_STRFUNC, key);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+}
+
+/**
+ * epc_publisher_get_handler_flags:
+ * @publisher: a #EpcPublisher
+ * @key: the key of the resource to inspect
+ *
+ * Queries the flags declared for the contents handler of @key.
+ * See epc_publisher_set_handler_flags() for details.
+ *
+ * Returns: The #EpcHandlerFlags of the resource,
+ * or #EPC_HANDLER_DEFAULT when there is no resource for @key.
+ *
+ * Since: 1.10
+ */
+EpcHandlerFlags
+epc_publisher_get_handler_flags (EpcPublisher *self,
+                                 const gchar  *key)
+{
+  EpcHandlerFlags flags = EPC_HANDLER_DEFAULT;
+  EpcResource *resource;
+
+  g_return_val_if_fail (EPC_IS_PUBLISHER (self), EPC_HANDLER_DEFAULT);
+  g_return_val_if_fail (NULL != key, EPC_HANDLER_DEFAULT);
+
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  resource = g_hash_table_lookup (self->priv->resources, key);
+
+  if (resource)
+    flags = epc_resource_get_flags (resource);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  return flags;
+}
+
 /**
  * epc_publisher_add_bookmark:
  * @publisher: a #EpcResource
@@ -2145,6 +4967,42 @@ epc_publisher_set_auth_flags (EpcPublisher *self,
   g_object_set (self, "auth-flags", flags, NULL);
 }
 
+/**
+ * epc_publisher_set_handler_threads:
+ * @publisher: a #EpcPublisher
+ * @max_threads: the maximum number of handler threads
+ *
+ * Changes the maximum number of threads running thread-safe contents
+ * handlers. See #EpcPublisher:handler-threads for details.
+ *
+ * Since: 1.10
+ */
+void
+epc_publisher_set_handler_threads (EpcPublisher *self,
+                                   gint          max_threads)
+{
+  g_return_if_fail (EPC_IS_PUBLISHER (self));
+  g_object_set (self, "handler-threads", max_threads, NULL);
+}
+
+/**
+ * epc_publisher_set_listener_threads:
+ * @publisher: a #EpcPublisher
+ * @n_threads: the number of additional listener threads
+ *
+ * Changes the number of additional threads accepting connections.
+ * See #EpcPublisher:listener-threads for details.
+ *
+ * Since: 1.10
+ */
+void
+epc_publisher_set_listener_threads (EpcPublisher *self,
+                                    gint          n_threads)
+{
+  g_return_if_fail (EPC_IS_PUBLISHER (self));
+  g_object_set (self, "listener-threads", n_threads, NULL);
+}
+
 /**
  * epc_publisher_get_service_name:
  * @publisher: a #EpcPublisher
@@ -2259,6 +5117,42 @@ epc_publisher_get_auth_flags (EpcPublisher *self)
   return self->priv->auth_flags;
 }
 
+/**
+ * epc_publisher_get_handler_threads:
+ * @publisher: a #EpcPublisher
+ *
+ * Queries the maximum number of threads running thread-safe contents
+ * handlers. See #EpcPublisher:handler-threads for details.
+ *
+ * Returns: The maximum number of handler threads.
+ *
+ * Since: 1.10
+ */
+gint
+epc_publisher_get_handler_threads (EpcPublisher *self)
+{
+  g_return_val_if_fail (EPC_IS_PUBLISHER (self), 0);
+  return self->priv->handler_threads;
+}
+
+/**
+ * epc_publisher_get_listener_threads:
+ * @publisher: a #EpcPublisher
+ *
+ * Queries the number of additional threads accepting connections.
+ * See #EpcPublisher:listener-threads for details.
+ *
+ * Returns: The number of additional listener threads.
+ *
+ * Since: 1.10
+ */
+gint
+epc_publisher_get_listener_threads (EpcPublisher *self)
+{
+  g_return_val_if_fail (EPC_IS_PUBLISHER (self), 0);
+  return self->priv->listener_threads;
+}
+
 /**
  * epc_publisher_get_service_cookie:
  * @publisher: a #EpcPublisher
@@ -2329,7 +5223,7 @@ epc_publisher_run (EpcPublisher  *self,
 
   if (NULL == self->priv->server_loop)
     {
-      self->priv->server_loop = g_main_loop_new (NULL, FALSE);
+      self->priv->server_loop = g_main_loop_new (self->priv->server_context, FALSE);
 
       g_main_loop_run (self->priv->server_loop);
 
@@ -2353,6 +5247,14 @@ epc_publisher_run (EpcPublisher  *self,
  * To stop the server component call epc_publisher_quit().
  * See epc_publisher_run() for additional information.
  *
+ * The server dispatches its requests from the thread-default main context
+ * of the calling thread (see g_main_context_push_thread_default()). No
+ * library-wide locks are held while an #EpcContentsHandler or an
+ * #EpcAuthHandler runs, so publishers running in separate threads serve
+ * their requests concurrently. See #EpcPublisher:listener-threads for
+ * serving the requests of a single publisher from multiple threads. Socket
+ * errors of those listeners are reported in the #G_IO_ERROR domain.
+ *
  * Returns: %TRUE when the publisher was successfully started,
  * %FALSE if an error occurred.
  */
@@ -2418,6 +5320,7 @@ epc_publisher_quit (EpcPublisher *self)
 
   /* prevent new requests, and also cleanup auth handlers (#510435) */
   epc_publisher_remove_handlers (self);
+  epc_publisher_stop_listeners (self);
 
   if (self->priv->server_loop)
     g_main_loop_quit (self->priv->server_loop);
@@ -2446,6 +5349,12 @@ epc_publisher_quit (EpcPublisher *self)
       self->priv->server = NULL;
     }
 
+  if (self->priv->server_context)
+    {
+      g_main_context_unref (self->priv->server_context);
+      self->priv->server_context = NULL;
+    }
+
   self->priv->server_started = FALSE;
 
   return was_running;
@@ -2668,12 +5577,31 @@ gboolean
 epc_auth_context_check_password (const EpcAuthContext *context,
                                  const gchar          *password)
 {
+  EpcPublisher *publisher;
+  SoupAuthDomain *server_auth = NULL;
+  gboolean matches = FALSE;
+
   g_return_val_if_fail (NULL != context, FALSE);
   g_return_val_if_fail (NULL != password, FALSE);
 
-  return soup_auth_domain_check_password (context->publisher->priv->server_auth,
-                                          context->message, context->username,
-                                          password);
+  publisher = context->publisher;
+
+  /* Thread-safe auth handlers might run in a listener thread. */
+  g_rec_mutex_lock (&epc_publisher_lock);
+
+  if (publisher->priv->server_auth)
+    server_auth = g_object_ref (publisher->priv->server_auth);
+
+  g_rec_mutex_unlock (&epc_publisher_lock);
+
+  if (server_auth)
+    {
+      matches = soup_auth_domain_check_password (server_auth, context->message,
+                                                 context->username, password);
+      g_object_unref (server_auth);
+    }
+
+  return matches;
 }
 
 /* vim: set sw=2 sta et spl=en spell: */
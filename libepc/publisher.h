@@ -35,6 +35,7 @@ G_BEGIN_DECLS
 #define EPC_PUBLISHER_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS((obj), EPC_TYPE_PUBLISHER, EpcPublisherClass))
 
 typedef struct _EpcAuthContext                  EpcAuthContext;
+typedef struct _EpcContentsRequest              EpcContentsRequest;
 typedef struct _EpcPublisher                    EpcPublisher;
 typedef struct _EpcPublisherClass               EpcPublisherClass;
 typedef struct _EpcPublisherPrivate             EpcPublisherPrivate;
@@ -57,6 +58,26 @@ typedef EpcContents* (*EpcContentsHandler) (EpcPublisher   *publisher,
                                             const gchar    *key,
                                             gpointer        user_data);
 
+/**
+ * EpcAsyncContentsHandler:
+ * @publisher: the #EpcPublisher
+ * @key: the unique key
+ * @request: the pending #EpcContentsRequest
+ * @user_data: user data set when the signal handler was installed
+ *
+ * This callback is used to generate custom contents published with the
+ * #epc_publisher_add_async_handler function. Other than #EpcContentsHandler
+ * it doesn't return the contents, but passes them to
+ * epc_contents_request_complete() when they are available. This can happen
+ * after the callback has returned, and from any thread.
+ *
+ * Since: 1.10
+ */
+typedef void         (*EpcAsyncContentsHandler) (EpcPublisher       *publisher,
+                                                 const gchar        *key,
+                                                 EpcContentsRequest *request,
+                                                 gpointer            user_data);
+
 /**
  * EpcAuthHandler:
  * @context: the #EpcAuthContext
@@ -107,6 +128,28 @@ typedef enum /*< flags >*/
   EPC_AUTH_PASSWORD_TEXT_NEEDED =       (1 << 0)
 } EpcAuthFlags;
 
+/**
+ * EpcHandlerFlags:
+ * @EPC_HANDLER_DEFAULT: The default handler settings.
+ * @EPC_HANDLER_THREAD_SAFE: Set this flag when your #EpcContentsHandler
+ * can be called from any thread, also concurrently. Such handlers are
+ * run in a thread pool when the #EpcPublisher:handler-threads property
+ * is not zero, and are called directly by the threads of the
+ * #EpcPublisher:listener-threads property. Other handlers are always
+ * called from the main context of the thread which started the publisher.
+ * This also applies to the #EpcAuthHandler of the key.
+ *
+ * These flags declare properties of the contents handlers installed by
+ * epc_publisher_add_handler(). See epc_publisher_set_handler_flags().
+ *
+ * Since: 1.10
+ */
+typedef enum /*< flags >*/
+{
+  EPC_HANDLER_DEFAULT =                  0,
+  EPC_HANDLER_THREAD_SAFE =             (1 << 0)
+} EpcHandlerFlags;
+
 /**
  * EpcPublisher:
  *
@@ -155,6 +198,10 @@ void                  epc_publisher_set_collision_handling (EpcPublisher
                                                             EpcCollisionHandling   method);
 void                  epc_publisher_set_service_cookie     (EpcPublisher          *publisher,
                                                             const gchar           *cookie);
+void                  epc_publisher_set_handler_threads    (EpcPublisher          *publisher,
+                                                            gint                   max_threads);
+void                  epc_publisher_set_listener_threads   (EpcPublisher          *publisher,
+                                                            gint                   n_threads);
 
 const gchar* epc_publisher_get_service_name       (EpcPublisher          *publisher);
 const gchar* epc_publisher_get_service_domain     (EpcPublisher          *publisher);
@@ -165,6 +212,8 @@ const gchar* epc_publisher_get_contents_path      (EpcPublisher          *publis
 EpcAuthFlags          epc_publisher_get_auth_flags         (EpcPublisher          *publisher);
 EpcCollisionHandling  epc_publisher_get_collision_handling (EpcPublisher          *publisher);
 const gchar* epc_publisher_get_service_cookie     (EpcPublisher          *publisher);
+gint                  epc_publisher_get_handler_threads    (EpcPublisher          *publisher);
+gint                  epc_publisher_get_listener_threads   (EpcPublisher          *publisher);
 
 void                  epc_publisher_add                    (EpcPublisher          *publisher,
                                                             const gchar           *key,
@@ -173,11 +222,20 @@ void                  epc_publisher_add                    (EpcPublisher
 void                  epc_publisher_add_file               (EpcPublisher          *publisher,
                                                             const gchar           *key,
                                                             const gchar           *filename);
+void                  epc_publisher_add_file_full          (EpcPublisher          *publisher,
+                                                            const gchar           *key,
+                                                            const gchar           *filename,
+                                                            const gchar           *mime_type);
 void                  epc_publisher_add_handler            (EpcPublisher          *publisher,
                                                             const gchar           *key,
                                                             EpcContentsHandler     handler,
                                                             gpointer               user_data,
                                                             GDestroyNotify         destroy_data);
+void                  epc_publisher_add_async_handler      (EpcPublisher          *publisher,
+                                                            const gchar           *key,
+                                                            EpcAsyncContentsHandler handler,
+                                                            gpointer               user_data,
+                                                            GDestroyNotify         destroy_data);
 
 void                  epc_publisher_set_auth_handler       (EpcPublisher          *publisher,
                                                             const gchar           *key,
@@ -185,6 +243,12 @@ void                  epc_publisher_set_auth_handler       (EpcPublisher
                                                             gpointer               user_data,
                                                             GDestroyNotify         destroy_data);
 
+void                  epc_publisher_set_handler_flags      (EpcPublisher          *publisher,
+                                                            const gchar           *key,
+                                                            EpcHandlerFlags        flags);
+EpcHandlerFlags       epc_publisher_get_handler_flags      (EpcPublisher          *publisher,
+                                                            const gchar           *key);
+
 void                  epc_publisher_add_bookmark           (EpcPublisher          *publisher,
                                                             const gchar           *key,
                                                             const gchar           *label);
@@ -219,6 +283,11 @@ const gchar* epc_auth_context_get_password        (const EpcAuthContext  *contex
 gboolean              epc_auth_context_check_password      (const EpcAuthContext  *context,
                                                             const gchar           *password);
 
+EpcPublisher*         epc_contents_request_get_publisher   (const EpcContentsRequest *request);
+const gchar*          epc_contents_request_get_key         (const EpcContentsRequest *request);
+void                  epc_contents_request_complete        (EpcContentsRequest    *request,
+                                                            EpcContents           *contents);
+
 G_END_DECLS
 
 #endif /* __EPC_PUBLISHER_H__ */
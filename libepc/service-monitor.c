@@ -59,7 +59,12 @@ enum
   PROP_SERVICE_TYPES,
   PROP_APPLICATION,
   PROP_DOMAIN,
-  PROP_SKIP_OUR_OWN
+  PROP_SKIP_OUR_OWN,
+  PROP_NAME_FILTER,
+  PROP_MAX_RESOLVERS,
+  PROP_RESOLVES_QUEUED,
+  PROP_RESOLVES_ACTIVE,
+  PROP_RESOLVES_COMPLETED
 };
 
 enum
@@ -70,6 +75,47 @@ enum
   SIGNAL_LAST
 };
 
+typedef struct _EpcBrowsedService EpcBrowsedService;
+typedef struct _EpcNameFilterUpdate EpcNameFilterUpdate;
+
+typedef enum
+{
+  EPC_SERVICE_SKIPPED,
+  EPC_SERVICE_QUEUED,
+  EPC_SERVICE_RESOLVING,
+  EPC_SERVICE_RESOLVED
+}
+EpcServiceState;
+
+/* A service announced by one of the browsers. Services are resolved
+ * in the order they were found, with at most #EpcServiceMonitor:max-resolvers
+ * resolvers running at the same time. Services whose name doesn't match the
+ * #EpcServiceMonitor:name-filter property are skipped.
+ */
+struct _EpcBrowsedService
+{
+  EpcServiceMonitor    *monitor;
+  AvahiClient          *client;
+  AvahiServiceResolver *resolver;
+  EpcServiceState       state;
+  EpcServiceInfo       *info;
+
+  AvahiIfIndex          interface;
+  AvahiProtocol         protocol;
+  gchar                *name;
+  gchar                *type;
+  gchar                *domain;
+};
+
+/* A change of the #EpcServiceMonitor:name-filter property, waiting to be
+ * applied in the main context running the browsers of the monitor.
+ */
+struct _EpcNameFilterUpdate
+{
+  EpcServiceMonitor    *monitor;
+  gchar               **name_filter;
+};
+
 /**
  * EpcServiceMonitorPrivate:
  *
@@ -82,18 +128,256 @@ struct _EpcServiceMonitorPrivate
   gchar   *domain;
   gchar  **types;
   gboolean skip_our_own;
+
+  gchar      **name_filter;
+  GHashTable  *services;
+  GQueue       queue;
+
+  gint         max_resolvers;
+  guint        active_resolvers;
+  guint        completed_resolvers;
+
+  GRecMutex    directory_lock;
+  GHashTable  *directory;
+  guint        n_resolved;
+
+  /* Copies of the resolver counters for readers in other threads,
+   * updated by epc_service_monitor_publish_counts(). */
+  guint        n_queued;
+  guint        n_active;
+  guint        n_completed;
 };
 
 static guint signals[SIGNAL_LAST];
 
 G_DEFINE_TYPE (EpcServiceMonitor, epc_service_monitor, G_TYPE_OBJECT);
 
+static void epc_service_monitor_resolve_next (EpcServiceMonitor *self);
+
+static void
+epc_browsed_service_free (gpointer data)
+{
+  EpcBrowsedService *service = data;
+
+  if (service->resolver)
+    avahi_service_resolver_free (service->resolver);
+  if (service->info)
+    epc_service_info_unref (service->info);
+
+  g_free (service->name);
+  g_free (service->type);
+  g_free (service->domain);
+
+  g_slice_free (EpcBrowsedService, service);
+}
+
+static gchar*
+epc_browsed_service_key (AvahiIfIndex   interface,
+                         AvahiProtocol  protocol,
+                         const gchar   *name,
+                         const gchar   *type)
+{
+  return g_strdup_printf ("%d\n%d\n%s\n%s", interface, protocol, name, type);
+}
+
+/* Drops a service which failed to resolve, so that it gets
+ * resolved again when the browsers announce it the next time.
+ */
+static void
+epc_service_monitor_forget (EpcServiceMonitor *self,
+                            EpcBrowsedService *service)
+{
+  gchar *key;
+
+  key = epc_browsed_service_key (service->interface, service->protocol,
+                                 service->name, service->type);
+  g_hash_table_remove (self->priv->services, key);
+  g_free (key);
+}
+
 static void
 epc_service_monitor_init (EpcServiceMonitor *self)
 {
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
                                             EPC_TYPE_SERVICE_MONITOR,
                                             EpcServiceMonitorPrivate);
+
+  self->priv->services = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                epc_browsed_service_free);
+  g_queue_init (&self->priv->queue);
+
+  self->priv->directory = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify) g_slist_free);
+  g_rec_mutex_init (&self->priv->directory_lock);
+}
+
+/* The directory indexes resolved services by name. It is guarded by a lock,
+ * as consumers might query it from other threads than the one running
+ * the monitor.
+ */
+static void
+epc_service_monitor_directory_add (EpcServiceMonitor *self,
+                                   EpcBrowsedService *service)
+{
+  GSList *services;
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+
+  services = g_hash_table_lookup (self->priv->directory, service->name);
+  g_hash_table_steal (self->priv->directory, service->name);
+
+  services = g_slist_prepend (services, service);
+  g_hash_table_insert (self->priv->directory, g_strdup (service->name), services);
+  self->priv->n_resolved += 1;
+
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+}
+
+static void
+epc_service_monitor_directory_remove (EpcServiceMonitor *self,
+                                      EpcBrowsedService *service)
+{
+  gpointer key = NULL;
+  GSList *services;
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+
+  if (g_hash_table_lookup_extended (self->priv->directory, service->name,
+                                    &key, (gpointer*) &services))
+    {
+      g_hash_table_steal (self->priv->directory, service->name);
+      services = g_slist_remove (services, service);
+
+      if (services)
+        g_hash_table_insert (self->priv->directory, key, services);
+      else
+        g_free (key);
+
+      self->priv->n_resolved -= 1;
+    }
+
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+}
+
+/* The resolver queue is only touched from the main context running the
+ * browsers, but its counters can be queried from any thread.
+ */
+static void
+epc_service_monitor_publish_counts (EpcServiceMonitor *self)
+{
+  g_rec_mutex_lock (&self->priv->directory_lock);
+  self->priv->n_queued = g_queue_get_length (&self->priv->queue);
+  self->priv->n_active = self->priv->active_resolvers;
+  self->priv->n_completed = self->priv->completed_resolvers;
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+}
+
+static gboolean
+epc_service_monitor_match_name (EpcServiceMonitor *self,
+                                const gchar       *name)
+{
+  gchar **iter;
+
+  if (!self->priv->name_filter)
+    return TRUE;
+
+  for (iter = self->priv->name_filter; *iter; ++iter)
+    if (g_str_equal (*iter, name))
+      return TRUE;
+
+  return FALSE;
+}
+
+static void
+epc_service_monitor_apply_name_filter (EpcServiceMonitor  *self,
+                                       gchar             **name_filter)
+{
+  GHashTableIter iter;
+  gpointer data;
+
+  /* The directory lock also guards the filter against readers
+   * of the name-filter property in other threads. */
+  g_rec_mutex_lock (&self->priv->directory_lock);
+  g_strfreev (self->priv->name_filter);
+  self->priv->name_filter = name_filter;
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+
+  /* Resolve the services skipped so far, which match the new filter. */
+  g_hash_table_iter_init (&iter, self->priv->services);
+
+  while (g_hash_table_iter_next (&iter, NULL, &data))
+    {
+      EpcBrowsedService *service = data;
+
+      if (EPC_SERVICE_SKIPPED == service->state &&
+          epc_service_monitor_match_name (self, service->name))
+        {
+          service->state = EPC_SERVICE_QUEUED;
+          g_queue_push_tail (&self->priv->queue, service);
+        }
+    }
+
+  epc_service_monitor_resolve_next (self);
+}
+
+static gboolean
+epc_service_monitor_name_filter_cb (gpointer data)
+{
+  EpcNameFilterUpdate *update = data;
+  EpcServiceMonitor *self = update->monitor;
+
+  /* The monitor might have been disposed meanwhile. */
+  if (self->priv->services)
+    {
+      epc_service_monitor_apply_name_filter (self, update->name_filter);
+      update->name_filter = NULL;
+    }
+
+  return FALSE;
+}
+
+static void
+epc_name_filter_update_free (gpointer data)
+{
+  EpcNameFilterUpdate *update = data;
+
+  g_object_unref (update->monitor);
+  g_strfreev (update->name_filter);
+  g_slice_free (EpcNameFilterUpdate, update);
+}
+
+/* The browsers and resolvers of the monitor are only touched from the
+ * main context running Avahi's poll, which is the default main context.
+ * Changes of the name filter might come from other threads, like from
+ * consumers sharing this monitor, so they are applied in that context.
+ */
+static void
+epc_service_monitor_real_set_name_filter (EpcServiceMonitor *self,
+                                          const GValue      *value)
+{
+  EpcNameFilterUpdate *update;
+
+  /* No browser runs yet while the monitor is constructed. */
+  if (!self->priv->browsers)
+    {
+      epc_service_monitor_apply_name_filter (self, g_value_dup_boxed (value));
+      return;
+    }
+
+  update = g_slice_new0 (EpcNameFilterUpdate);
+  update->monitor = g_object_ref (self);
+  update->name_filter = g_value_dup_boxed (value);
+
+  g_main_context_invoke_full (NULL, G_PRIORITY_DEFAULT,
+                              epc_service_monitor_name_filter_cb,
+                              update, epc_name_filter_update_free);
+}
+
+static gboolean
+epc_service_monitor_resolve_next_cb (gpointer data)
+{
+  epc_service_monitor_resolve_next (data);
+  return FALSE;
 }
 
 static void
@@ -125,6 +409,21 @@ epc_service_monitor_set_property (GObject      *object,
         self->priv->skip_our_own = g_value_get_boolean (value);
         break;
 
+      case PROP_NAME_FILTER:
+        epc_service_monitor_real_set_name_filter (self, value);
+        break;
+
+      case PROP_MAX_RESOLVERS:
+        self->priv->max_resolvers = g_value_get_int (value);
+
+        /* Start further resolvers in the context running the browsers. */
+        if (self->priv->browsers)
+          g_main_context_invoke_full (NULL, G_PRIORITY_DEFAULT,
+                                      epc_service_monitor_resolve_next_cb,
+                                      g_object_ref (self), g_object_unref);
+
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -157,6 +456,34 @@ epc_service_monitor_get_property (GObject    *object,
         g_value_set_boolean (value, self->priv->skip_our_own);
         break;
 
+      case PROP_NAME_FILTER:
+        g_rec_mutex_lock (&self->priv->directory_lock);
+        g_value_set_boxed (value, self->priv->name_filter);
+        g_rec_mutex_unlock (&self->priv->directory_lock);
+        break;
+
+      case PROP_MAX_RESOLVERS:
+        g_value_set_int (value, self->priv->max_resolvers);
+        break;
+
+      case PROP_RESOLVES_QUEUED:
+        g_rec_mutex_lock (&self->priv->directory_lock);
+        g_value_set_uint (value, self->priv->n_queued);
+        g_rec_mutex_unlock (&self->priv->directory_lock);
+        break;
+
+      case PROP_RESOLVES_ACTIVE:
+        g_rec_mutex_lock (&self->priv->directory_lock);
+        g_value_set_uint (value, self->priv->n_active);
+        g_rec_mutex_unlock (&self->priv->directory_lock);
+        break;
+
+      case PROP_RESOLVES_COMPLETED:
+        g_rec_mutex_lock (&self->priv->directory_lock);
+        g_value_set_uint (value, self->priv->n_completed);
+        g_rec_mutex_unlock (&self->priv->directory_lock);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -178,11 +505,14 @@ epc_service_monitor_resolver_cb (AvahiServiceResolver   *resolver,
                                  AvahiLookupResultFlags  flags G_GNUC_UNUSED,
                                  void                   *data)
 {
-  EpcServiceMonitor *self = EPC_SERVICE_MONITOR (data);
+  EpcBrowsedService *service = data;
+  EpcServiceMonitor *self = service->monitor;
+  EpcServiceInfo *info = NULL;
   gchar ifname[IFNAMSIZ];
-  EpcServiceInfo *info;
   gint error;
 
+  g_assert (resolver == service->resolver);
+
   switch (event)
     {
       case AVAHI_RESOLVER_FOUND:
@@ -194,8 +524,6 @@ epc_service_monitor_resolver_cb (AvahiServiceResolver   *resolver,
 
         info = epc_service_info_new_full (type, hostname, port, txt, address,
                                           if_indextoname (ifindex, ifname));
-        g_signal_emit (self, signals[SIGNAL_SERVICE_FOUND], 0, name, info);
-        epc_service_info_unref (info);
         break;
 
       case AVAHI_RESOLVER_FAILURE:
@@ -205,6 +533,152 @@ epc_service_monitor_resolver_cb (AvahiServiceResolver   *resolver,
     }
 
   avahi_service_resolver_free (resolver);
+  service->resolver = NULL;
+
+  if (info)
+    {
+      service->state = EPC_SERVICE_RESOLVED;
+      service->info = epc_service_info_ref (info);
+      epc_service_monitor_directory_add (self, service);
+    }
+  else
+    epc_service_monitor_forget (self, service);
+
+  self->priv->active_resolvers -= 1;
+  self->priv->completed_resolvers += 1;
+  epc_service_monitor_publish_counts (self);
+
+  g_object_ref (self);
+
+  if (info)
+    {
+      g_signal_emit (self, signals[SIGNAL_SERVICE_FOUND], 0, name, info);
+      epc_service_info_unref (info);
+    }
+
+  epc_service_monitor_resolve_next (self);
+  g_object_unref (self);
+}
+
+/* Starts resolvers for queued services, until the limit is reached. */
+static void
+epc_service_monitor_resolve_next (EpcServiceMonitor *self)
+{
+  while (!g_queue_is_empty (&self->priv->queue) &&
+         (self->priv->max_resolvers <= 0 ||
+          self->priv->active_resolvers < (guint) self->priv->max_resolvers))
+    {
+      EpcBrowsedService *service = g_queue_pop_head (&self->priv->queue);
+
+      service->resolver =
+        avahi_service_resolver_new (service->client,
+                                    service->interface, service->protocol,
+                                    service->name, service->type, service->domain,
+                                    service->protocol, 0,
+                                    epc_service_monitor_resolver_cb, service);
+
+      if (G_UNLIKELY (!service->resolver))
+        {
+          gint error = avahi_client_errno (service->client);
+
+          g_warning ("%s: %s (%d)", G_STRFUNC, avahi_strerror (error), error);
+          self->priv->completed_resolvers += 1;
+          epc_service_monitor_forget (self, service);
+
+          continue;
+        }
+
+      service->state = EPC_SERVICE_RESOLVING;
+      self->priv->active_resolvers += 1;
+    }
+
+  /* Each change of the resolver queue ends up here. */
+  epc_service_monitor_publish_counts (self);
+
+  if (EPC_DEBUG_LEVEL (1))
+    g_debug ("%s: resolvers: queued=%u, active=%u, completed=%u", G_STRLOC,
+             g_queue_get_length (&self->priv->queue),
+             self->priv->active_resolvers,
+             self->priv->completed_resolvers);
+}
+
+static void
+epc_service_monitor_service_new (EpcServiceMonitor *self,
+                                 AvahiClient       *client,
+                                 AvahiIfIndex       interface,
+                                 AvahiProtocol      protocol,
+                                 const gchar       *name,
+                                 const gchar       *type,
+                                 const gchar       *domain)
+{
+  EpcBrowsedService *service;
+  gchar *key;
+
+  key = epc_browsed_service_key (interface, protocol, name, type);
+
+  if (g_hash_table_lookup (self->priv->services, key))
+    {
+      if (EPC_DEBUG_LEVEL (1))
+        g_debug ("%s: `%s' is known already", G_STRLOC, name);
+
+      g_free (key);
+      return;
+    }
+
+  service = g_slice_new0 (EpcBrowsedService);
+  service->monitor = self;
+  service->client = client;
+  service->interface = interface;
+  service->protocol = protocol;
+  service->name = g_strdup (name);
+  service->type = g_strdup (type);
+  service->domain = g_strdup (domain);
+
+  g_hash_table_insert (self->priv->services, key, service);
+
+  if (epc_service_monitor_match_name (self, name))
+    {
+      service->state = EPC_SERVICE_QUEUED;
+      g_queue_push_tail (&self->priv->queue, service);
+      epc_service_monitor_resolve_next (self);
+    }
+  else
+    {
+      if (EPC_DEBUG_LEVEL (1))
+        g_debug ("%s: skipping `%s', not matching the name filter", G_STRLOC, name);
+
+      service->state = EPC_SERVICE_SKIPPED;
+    }
+}
+
+static void
+epc_service_monitor_service_removed (EpcServiceMonitor *self,
+                                     AvahiIfIndex       interface,
+                                     AvahiProtocol      protocol,
+                                     const gchar       *name,
+                                     const gchar       *type)
+{
+  EpcBrowsedService *service;
+  gchar *key;
+
+  key = epc_browsed_service_key (interface, protocol, name, type);
+  service = g_hash_table_lookup (self->priv->services, key);
+
+  if (service)
+    {
+      /* Cancel pending resolvers of vanished services. */
+      if (EPC_SERVICE_QUEUED == service->state)
+        g_queue_remove (&self->priv->queue, service);
+      else if (EPC_SERVICE_RESOLVING == service->state)
+        self->priv->active_resolvers -= 1;
+      else if (service->info)
+        epc_service_monitor_directory_remove (self, service);
+
+      g_hash_table_remove (self->priv->services, key);
+      epc_service_monitor_resolve_next (self);
+    }
+
+  g_free (key);
 }
 
 static void
@@ -231,12 +705,13 @@ epc_service_monitor_browser_cb (AvahiServiceBrowser    *browser,
     {
       case AVAHI_BROWSER_NEW:
         if (!self->priv->skip_our_own || !(flags & AVAHI_LOOKUP_RESULT_OUR_OWN))
-          avahi_service_resolver_new (client, interface, protocol, name, type, domain,
-                                      protocol, 0, epc_service_monitor_resolver_cb, self);
+          epc_service_monitor_service_new (self, client, interface, protocol,
+                                           name, type, domain);
 
         break;
 
       case AVAHI_BROWSER_REMOVE:
+        epc_service_monitor_service_removed (self, interface, protocol, name, type);
         g_signal_emit (self, signals[SIGNAL_SERVICE_REMOVED], 0, name, type);
         break;
 
@@ -314,6 +789,30 @@ epc_service_monitor_dispose (GObject *object)
       self->priv->browsers = g_slist_delete_link (self->priv->browsers, self->priv->browsers);
     }
 
+  g_queue_clear (&self->priv->queue);
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+  g_hash_table_remove_all (self->priv->directory);
+  self->priv->n_resolved = 0;
+  self->priv->n_queued = 0;
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+
+  if (self->priv->services)
+    {
+      g_hash_table_unref (self->priv->services);
+      self->priv->services = NULL;
+    }
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+
+  if (self->priv->name_filter)
+    {
+      g_strfreev (self->priv->name_filter);
+      self->priv->name_filter = NULL;
+    }
+
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+
   if (self->priv->types)
     {
       g_strfreev (self->priv->types);
@@ -335,6 +834,17 @@ epc_service_monitor_dispose (GObject *object)
   G_OBJECT_CLASS (epc_service_monitor_parent_class)->dispose (object);
 }
 
+static void
+epc_service_monitor_finalize (GObject *object)
+{
+  EpcServiceMonitor *self = EPC_SERVICE_MONITOR (object);
+
+  g_hash_table_unref (self->priv->directory);
+  g_rec_mutex_clear (&self->priv->directory_lock);
+
+  G_OBJECT_CLASS (epc_service_monitor_parent_class)->finalize (object);
+}
+
 static void
 epc_service_monitor_class_init (EpcServiceMonitorClass *cls)
 {
@@ -344,6 +854,7 @@ epc_service_monitor_class_init (EpcServiceMonitorClass *cls)
   oclass->get_property = epc_service_monitor_get_property;
   oclass->constructed = epc_service_monitor_constructed;
   oclass->dispose = epc_service_monitor_dispose;
+  oclass->finalize = epc_service_monitor_finalize;
 
   g_object_class_install_property (oclass, PROP_DOMAIN,
                                    g_param_spec_string ("domain", "Domain",
@@ -377,6 +888,91 @@ epc_service_monitor_class_init (EpcServiceMonitorClass *cls)
                                                          G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
                                                          G_PARAM_STATIC_BLURB));
 
+  /**
+   * EpcServiceMonitor:name-filter:
+   *
+   * The service names to resolve, or %NULL for resolving all services
+   * found. Services with other names are still noticed, but not resolved
+   * until their name is added to the filter. This avoids flooding the
+   * network with resolve queries when only a few services are of interest.
+   *
+   * The filter can be changed from any thread. Once the monitor is
+   * running, changes are applied in the default main context, which runs
+   * the service browsers.
+   *
+   * Since: 1.10
+   */
+  g_object_class_install_property (oclass, PROP_NAME_FILTER,
+                                   g_param_spec_boxed ("name-filter", "Name Filter",
+                                                       "The service names to resolve",
+                                                       G_TYPE_STRV,
+                                                       G_PARAM_READWRITE |
+                                                       G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
+                                                       G_PARAM_STATIC_BLURB));
+
+  /**
+   * EpcServiceMonitor:max-resolvers:
+   *
+   * The maximum number of services resolved at the same time. Additional
+   * services are queued until a running resolver finishes. Zero removes
+   * the limit.
+   *
+   * Since: 1.10
+   */
+  g_object_class_install_property (oclass, PROP_MAX_RESOLVERS,
+                                   g_param_spec_int ("max-resolvers", "Maximum Resolvers",
+                                                     "The maximum number of services resolved at the same time",
+                                                     0, G_MAXINT, 16,
+                                                     G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                                                     G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
+                                                     G_PARAM_STATIC_BLURB));
+
+  /**
+   * EpcServiceMonitor:resolves-queued:
+   *
+   * The number of services waiting for a resolver.
+   *
+   * Since: 1.10
+   */
+  g_object_class_install_property (oclass, PROP_RESOLVES_QUEUED,
+                                   g_param_spec_uint ("resolves-queued", "Queued Resolves",
+                                                      "The number of services waiting for a resolver",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READABLE |
+                                                      G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * EpcServiceMonitor:resolves-active:
+   *
+   * The number of services currently resolved.
+   *
+   * Since: 1.10
+   */
+  g_object_class_install_property (oclass, PROP_RESOLVES_ACTIVE,
+                                   g_param_spec_uint ("resolves-active", "Active Resolves",
+                                                      "The number of services currently resolved",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READABLE |
+                                                      G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
+  /**
+   * EpcServiceMonitor:resolves-completed:
+   *
+   * The number of resolvers which have finished, successfully or not.
+   * Resolvers cancelled because their service vanished are not counted.
+   *
+   * Since: 1.10
+   */
+  g_object_class_install_property (oclass, PROP_RESOLVES_COMPLETED,
+                                   g_param_spec_uint ("resolves-completed", "Completed Resolves",
+                                                      "The number of resolvers which have finished",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READABLE |
+                                                      G_PARAM_STATIC_NAME | G_PARAM_STATIC_NICK |
+                                                      G_PARAM_STATIC_BLURB));
+
   /**
    * EpcServiceMonitor::service-found:
    * @monitor: a #EpcServiceMonitor
@@ -590,3 +1186,265 @@ epc_service_monitor_get_skip_our_own (EpcServiceMonitor *self)
   g_return_val_if_fail (EPC_IS_SERVICE_MONITOR (self), FALSE);
   return self->priv->skip_our_own;
 }
+
+/**
+ * epc_service_monitor_set_name_filter:
+ * @monitor: a #EpcServiceMonitor
+ * @names: a %NULL terminated list of service names, or %NULL
+ *
+ * Updates the #EpcServiceMonitor:name-filter property.
+ *
+ * Since: 1.10
+ */
+void
+epc_service_monitor_set_name_filter (EpcServiceMonitor  *self,
+                                     gchar             **names)
+{
+  g_return_if_fail (EPC_IS_SERVICE_MONITOR (self));
+  g_object_set (self, "name-filter", names, NULL);
+}
+
+/**
+ * epc_service_monitor_get_name_filter:
+ * @monitor: a #EpcServiceMonitor
+ *
+ * Queries the current value of the #EpcServiceMonitor:name-filter property.
+ * The filter can be changed from any thread, so a copy is returned.
+ *
+ * Returns: A copy of the #EpcServiceMonitor:name-filter property, or %NULL.
+ * Free with g_strfreev() when no longer needed.
+ *
+ * Since: 1.10
+ */
+gchar**
+epc_service_monitor_get_name_filter (EpcServiceMonitor *self)
+{
+  gchar **names;
+
+  g_return_val_if_fail (EPC_IS_SERVICE_MONITOR (self), NULL);
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+  names = g_strdupv (self->priv->name_filter);
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+
+  return names;
+}
+
+/**
+ * epc_service_monitor_set_max_resolvers:
+ * @monitor: a #EpcServiceMonitor
+ * @max_resolvers: the maximum number of concurrent resolvers, or 0
+ *
+ * Updates the #EpcServiceMonitor:max-resolvers property.
+ *
+ * Since: 1.10
+ */
+void
+epc_service_monitor_set_max_resolvers (EpcServiceMonitor *self,
+                                       gint               max_resolvers)
+{
+  g_return_if_fail (EPC_IS_SERVICE_MONITOR (self));
+  g_object_set (self, "max-resolvers", max_resolvers, NULL);
+}
+
+/**
+ * epc_service_monitor_get_max_resolvers:
+ * @monitor: a #EpcServiceMonitor
+ *
+ * Queries the current value of the #EpcServiceMonitor:max-resolvers property.
+ *
+ * Returns: The current value of the #EpcServiceMonitor:max-resolvers property
+ *
+ * Since: 1.10
+ */
+gint
+epc_service_monitor_get_max_resolvers (EpcServiceMonitor *self)
+{
+  g_return_val_if_fail (EPC_IS_SERVICE_MONITOR (self), 0);
+  return self->priv->max_resolvers;
+}
+
+/**
+ * epc_service_monitor_get_resolver_counts:
+ * @monitor: a #EpcServiceMonitor
+ * @queued: return location for the number of queued services, or %NULL
+ * @active: return location for the number of running resolvers, or %NULL
+ * @completed: return location for the number of finished resolvers, or %NULL
+ *
+ * Queries the counters of the monitor's resolver queue. See
+ * #EpcServiceMonitor:resolves-queued, #EpcServiceMonitor:resolves-active
+ * and #EpcServiceMonitor:resolves-completed for details. This function
+ * can be called from any thread, the counters are retrieved atomically.
+ *
+ * Since: 1.10
+ */
+void
+epc_service_monitor_get_resolver_counts (EpcServiceMonitor *self,
+                                         guint             *queued,
+                                         guint             *active,
+                                         guint             *completed)
+{
+  g_return_if_fail (EPC_IS_SERVICE_MONITOR (self));
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+
+  if (queued)
+    *queued = self->priv->n_queued;
+  if (active)
+    *active = self->priv->n_active;
+  if (completed)
+    *completed = self->priv->n_completed;
+
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+}
+
+/**
+ * epc_service_monitor_lookup:
+ * @monitor: a #EpcServiceMonitor
+ * @name: the service name to look for
+ * @type: the service type to look for, or %NULL
+ * @interface: the network interface to look for, or %NULL
+ *
+ * Looks up a service the monitor has resolved, without waiting for the
+ * #EpcServiceMonitor::service-found signal. Passing %NULL for @type or
+ * @interface accepts any service type or network interface.
+ *
+ * Returns: A new reference to the service's description, or %NULL when no
+ * such service is known. Release it with epc_service_info_unref().
+ *
+ * Since: 1.10
+ */
+EpcServiceInfo*
+epc_service_monitor_lookup (EpcServiceMonitor *self,
+                            const gchar       *name,
+                            const gchar       *type,
+                            const gchar       *interface)
+{
+  EpcServiceInfo *info = NULL;
+  GSList *iter;
+
+  g_return_val_if_fail (EPC_IS_SERVICE_MONITOR (self), NULL);
+  g_return_val_if_fail (NULL != name, NULL);
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+
+  for (iter = g_hash_table_lookup (self->priv->directory, name); iter; iter = iter->next)
+    {
+      EpcBrowsedService *service = iter->data;
+      const gchar *service_interface;
+
+      if (type && !g_str_equal (type, service->type))
+        continue;
+
+      service_interface = epc_service_info_get_interface (service->info);
+
+      if (interface && g_strcmp0 (interface, service_interface))
+        continue;
+
+      info = epc_service_info_ref (service->info);
+      break;
+    }
+
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+
+  return info;
+}
+
+/**
+ * epc_service_monitor_foreach:
+ * @monitor: a #EpcServiceMonitor
+ * @name: the service name to visit, or %NULL
+ * @func: the function to call for each service
+ * @user_data: data to pass to @func
+ *
+ * Calls @func for each service the monitor has resolved. Passing %NULL for
+ * @name visits all services, otherwise only services called @name are
+ * visited. The function works on a snapshot of the monitor's directory,
+ * so @func is free to modify the monitor.
+ *
+ * Since: 1.10
+ */
+void
+epc_service_monitor_foreach (EpcServiceMonitor     *self,
+                             const gchar           *name,
+                             EpcServiceMonitorFunc  func,
+                             gpointer               user_data)
+{
+  GSList *snapshot = NULL;
+  GSList *iter;
+
+  g_return_if_fail (EPC_IS_SERVICE_MONITOR (self));
+  g_return_if_fail (NULL != func);
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+
+  if (name)
+    {
+      for (iter = g_hash_table_lookup (self->priv->directory, name); iter; iter = iter->next)
+        {
+          EpcBrowsedService *service = iter->data;
+
+          snapshot = g_slist_prepend (snapshot, epc_service_info_ref (service->info));
+          snapshot = g_slist_prepend (snapshot, g_strdup (service->name));
+        }
+    }
+  else
+    {
+      GHashTableIter services;
+      gpointer value;
+
+      g_hash_table_iter_init (&services, self->priv->directory);
+
+      while (g_hash_table_iter_next (&services, NULL, &value))
+        for (iter = value; iter; iter = iter->next)
+          {
+            EpcBrowsedService *service = iter->data;
+
+            snapshot = g_slist_prepend (snapshot, epc_service_info_ref (service->info));
+            snapshot = g_slist_prepend (snapshot, g_strdup (service->name));
+          }
+    }
+
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+
+  /* The snapshot alternates between names and service descriptions. */
+  while (snapshot)
+    {
+      gchar *service_name = snapshot->data;
+      EpcServiceInfo *info = snapshot->next->data;
+
+      func (self, service_name, info, user_data);
+
+      epc_service_info_unref (info);
+      g_free (service_name);
+
+      snapshot = g_slist_delete_link (snapshot, snapshot);
+      snapshot = g_slist_delete_link (snapshot, snapshot);
+    }
+}
+
+/**
+ * epc_service_monitor_get_n_services:
+ * @monitor: a #EpcServiceMonitor
+ *
+ * Queries the number of services the monitor has resolved, and which are
+ * still available. Services announced on multiple network interfaces or
+ * for multiple address families are counted once for each of them.
+ *
+ * Returns: The number of services known.
+ *
+ * Since: 1.10
+ */
+guint
+epc_service_monitor_get_n_services (EpcServiceMonitor *self)
+{
+  guint n_services;
+
+  g_return_val_if_fail (EPC_IS_SERVICE_MONITOR (self), 0);
+
+  g_rec_mutex_lock (&self->priv->directory_lock);
+  n_services = self->priv->n_resolved;
+  g_rec_mutex_unlock (&self->priv->directory_lock);
+
+  return n_services;
+}
@@ -76,6 +76,23 @@ struct _EpcServiceMonitorClass
                            const gchar        *type);
 };
 
+/**
+ * EpcServiceMonitorFunc:
+ * @monitor: the #EpcServiceMonitor
+ * @name: the name of the service
+ * @info: a description of the service
+ * @user_data: the user_data passed to epc_service_monitor_foreach()
+ *
+ * This callback is used by epc_service_monitor_foreach() to visit
+ * the services resolved by the @monitor.
+ *
+ * Since: 1.10
+ */
+typedef void (*EpcServiceMonitorFunc) (EpcServiceMonitor *monitor,
+                                       const gchar       *name,
+                                       EpcServiceInfo    *info,
+                                       gpointer           user_data);
+
 GType              epc_service_monitor_get_type           (void) G_GNUC_CONST;
 
 EpcServiceMonitor* epc_service_monitor_new                (const gchar       *application,
@@ -92,6 +109,28 @@ void               epc_service_monitor_set_skip_our_own   (EpcServiceMonitor *mo
                                                            gboolean           setting);
 gboolean           epc_service_monitor_get_skip_our_own   (EpcServiceMonitor *monitor);
 
+void               epc_service_monitor_set_name_filter    (EpcServiceMonitor *monitor,
+                                                           gchar            **names);
+gchar**            epc_service_monitor_get_name_filter    (EpcServiceMonitor *monitor);
+
+void               epc_service_monitor_set_max_resolvers  (EpcServiceMonitor *monitor,
+                                                           gint               max_resolvers);
+gint               epc_service_monitor_get_max_resolvers  (EpcServiceMonitor *monitor);
+void               epc_service_monitor_get_resolver_counts(EpcServiceMonitor *monitor,
+                                                           guint             *queued,
+                                                           guint             *active,
+                                                           guint             *completed);
+
+EpcServiceInfo*    epc_service_monitor_lookup             (EpcServiceMonitor *monitor,
+                                                           const gchar       *name,
+                                                           const gchar       *type,
+                                                           const gchar       *interface);
+void               epc_service_monitor_foreach            (EpcServiceMonitor *monitor,
+                                                           const gchar       *name,
+                                                           EpcServiceMonitorFunc func,
+                                                           gpointer           user_data);
+guint              epc_service_monitor_get_n_services     (EpcServiceMonitor *monitor);
+
 G_END_DECLS
 
 #endif /* __EPC_SERVICE_MONITOR_H__ */ 
@@ -0,0 +1,421 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test consumers using the cached endpoint of their publisher */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libepc/service-type.h>
+#include <libsoup/soup.h>
+
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_SERVICE_NAME  "Endpoint Cache Test"
+#define TEST_APPLICATION   "test-consumer-endpoint-cache"
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static gint publisher_port = 0;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+
+static gchar *publisher_fingerprint = NULL;
+static gint probe_count = 0;
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static EpcContents*
+probe_handler (EpcPublisher *self G_GNUC_UNUSED,
+               const gchar  *key G_GNUC_UNUSED,
+               gpointer      data G_GNUC_UNUSED)
+{
+  g_atomic_int_inc (&probe_count);
+  return epc_contents_new_dup ("text/plain", "probed", -1);
+}
+
+/* Fetches the certificate fingerprint the consumer is expected to cache. */
+static gchar*
+fetch_fingerprint (void)
+{
+  GTlsCertificate *certificate = NULL;
+  gchar *fingerprint = NULL;
+  SoupSession *session;
+  SoupMessage *message;
+  GByteArray *der = NULL;
+  gchar *uri;
+
+  uri = g_strdup_printf ("https://localhost:%d/", publisher_port);
+  session = soup_session_new_with_options (SOUP_SESSION_SSL_STRICT, FALSE, NULL);
+  message = soup_message_new ("GET", uri);
+
+  soup_session_send_message (session, message);
+
+  if (soup_message_get_https_status (message, &certificate, NULL) && certificate)
+    g_object_get (certificate, "certificate", &der, NULL);
+  if (!der)
+    g_error ("%s: no certificate received", G_STRLOC);
+
+  fingerprint = g_compute_checksum_for_data (G_CHECKSUM_SHA256, der->data, der->len);
+
+  g_byte_array_unref (der);
+  g_object_unref (message);
+  g_object_unref (session);
+  g_free (uri);
+
+  return fingerprint;
+}
+
+/* Finds a port nobody is listening on. */
+static gint
+find_dead_port (void)
+{
+  GError *error = NULL;
+  GSocketAddress *address;
+  GInetAddress *loopback;
+  GSocket *socket;
+  gint port;
+
+  socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM,
+                         G_SOCKET_PROTOCOL_TCP, &error);
+
+  if (!socket)
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  loopback = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  address = g_inet_socket_address_new (loopback, 0);
+
+  if (!g_socket_bind (socket, address, FALSE, &error))
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  g_object_unref (address);
+  address = g_socket_get_local_address (socket, &error);
+
+  if (!address)
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (address));
+
+  g_object_unref (address);
+  g_object_unref (loopback);
+  g_object_unref (socket);
+
+  return port;
+}
+
+static void
+write_cache (const gchar *filename,
+             EpcProtocol  protocol,
+             const gchar *application,
+             gint         port,
+             const gchar *fingerprint)
+{
+  GError *error = NULL;
+  GKeyFile *cache;
+  gchar *type;
+  gchar *data;
+  gsize length;
+
+  type = epc_service_type_new (protocol, application);
+
+  cache = g_key_file_new ();
+  g_key_file_set_string (cache, TEST_SERVICE_NAME, "type", type);
+  g_key_file_set_string (cache, TEST_SERVICE_NAME, "host", "localhost");
+  g_key_file_set_integer (cache, TEST_SERVICE_NAME, "port", port);
+  g_key_file_set_string (cache, TEST_SERVICE_NAME, "path", "/contents");
+
+  if (fingerprint)
+    g_key_file_set_string (cache, TEST_SERVICE_NAME, "fingerprint", fingerprint);
+
+  data = g_key_file_to_data (cache, &length, NULL);
+
+  if (!g_file_set_contents (filename, data, length, &error))
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  g_key_file_free (cache);
+  g_free (type);
+  g_free (data);
+}
+
+static gchar*
+read_cache (const gchar *filename,
+            const gchar *key)
+{
+  GError *error = NULL;
+  GKeyFile *cache;
+  gchar *value;
+
+  cache = g_key_file_new ();
+
+  if (!g_key_file_load_from_file (cache, filename, G_KEY_FILE_NONE, &error))
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  value = g_key_file_get_string (cache, TEST_SERVICE_NAME, key, NULL);
+  g_key_file_free (cache);
+
+  return value;
+}
+
+static EpcConsumer*
+create_consumer (const gchar *filename)
+{
+  EpcConsumer *consumer;
+
+  consumer = epc_consumer_new_for_name_full (TEST_SERVICE_NAME, TEST_APPLICATION, NULL);
+  epc_consumer_set_endpoint_cache (consumer, filename);
+
+  if (g_strcmp0 (filename, epc_consumer_get_endpoint_cache (consumer)))
+    g_error ("%s: endpoint cache not set", G_STRLOC);
+
+  return consumer;
+}
+
+static void
+check_lookup (EpcConsumer *consumer,
+              const gchar *key,
+              const gchar *expected)
+{
+  GError *error = NULL;
+  gchar *value;
+
+  value = epc_consumer_lookup (consumer, key, NULL, &error);
+
+  if (!value)
+    g_error ("%s: %s", G_STRLOC, error->message);
+  if (strcmp (value, expected))
+    g_error ("%s: unexpected value `%s'", G_STRLOC, value);
+
+  g_free (value);
+}
+
+static void
+check_cached_endpoint (const gchar *filename)
+{
+  EpcConsumer *consumer;
+
+  write_cache (filename, EPC_PROTOCOL_HTTPS, TEST_APPLICATION,
+               publisher_port, publisher_fingerprint);
+
+  consumer = create_consumer (filename);
+
+  if (!epc_consumer_is_publisher_resolved (consumer))
+    g_error ("%s: cached endpoint not used", G_STRLOC);
+
+  check_lookup (consumer, "value", "cached");
+  g_object_unref (consumer);
+}
+
+static void
+check_ignored_endpoint (const gchar *filename,
+                        EpcProtocol  protocol,
+                        const gchar *application,
+                        const gchar *fingerprint)
+{
+  EpcConsumer *consumer;
+
+  write_cache (filename, protocol, application, publisher_port, fingerprint);
+  consumer = create_consumer (filename);
+
+  if (epc_consumer_is_publisher_resolved (consumer))
+    g_error ("%s: cached endpoint used", G_STRLOC);
+
+  g_object_unref (consumer);
+}
+
+static void
+check_dead_endpoint (const gchar *filename)
+{
+  EpcConsumer *consumer;
+  gchar *port;
+
+  /* Nobody listens on the cached port, so the consumer
+   * must fall back to the endpoint found by service discovery. */
+  write_cache (filename, EPC_PROTOCOL_HTTPS, TEST_APPLICATION,
+               find_dead_port (), publisher_fingerprint);
+
+  consumer = create_consumer (filename);
+
+  if (!epc_consumer_is_publisher_resolved (consumer))
+    g_error ("%s: cached endpoint not used", G_STRLOC);
+
+  check_lookup (consumer, "value", "cached");
+  g_object_unref (consumer);
+
+  port = read_cache (filename, "port");
+
+  if (publisher_port != atoi (port))
+    g_error ("%s: dead endpoint still cached", G_STRLOC);
+
+  g_free (port);
+}
+
+static void
+check_mismatched_endpoint (const gchar *filename)
+{
+  EpcConsumer *consumer;
+  gchar *fingerprint;
+
+  /* The cached endpoint presents an unexpected certificate, so no request
+   * must reach it before service discovery has found the publisher. */
+  write_cache (filename, EPC_PROTOCOL_HTTPS, TEST_APPLICATION, publisher_port,
+               "0000000000000000000000000000000000000000000000000000000000000000");
+
+  consumer = create_consumer (filename);
+  g_atomic_int_set (&probe_count, 0);
+
+  if (!epc_consumer_is_publisher_resolved (consumer))
+    g_error ("%s: cached endpoint not used", G_STRLOC);
+
+  check_lookup (consumer, "probe", "probed");
+  g_object_unref (consumer);
+
+  if (1 != g_atomic_int_get (&probe_count))
+    g_error ("%s: request sent to unverified endpoint", G_STRLOC);
+
+  fingerprint = read_cache (filename, "fingerprint");
+
+  if (g_strcmp0 (fingerprint, publisher_fingerprint))
+    g_error ("%s: certificate not updated", G_STRLOC);
+
+  g_free (fingerprint);
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  gchar *filename = NULL;
+  GError *error = NULL;
+  GThread *thread;
+  gchar *prgname;
+  gint fd;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  fd = g_file_open_tmp ("test-consumer-endpoint-cache-XXXXXX", &filename, &error);
+
+  if (fd < 0)
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  close (fd);
+
+  publisher = epc_publisher_new (TEST_SERVICE_NAME, TEST_APPLICATION, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTPS);
+  epc_publisher_add (publisher, "value", "cached", -1);
+  epc_publisher_add_handler (publisher, "probe", probe_handler, NULL, NULL);
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  publisher_fingerprint = fetch_fingerprint ();
+
+  g_print ("1) CACHED ENDPOINT\n");
+  check_cached_endpoint (filename);
+
+  g_print ("2) FOREIGN ENDPOINT\n");
+  check_ignored_endpoint (filename, EPC_PROTOCOL_HTTPS,
+                          "some-other-application",
+                          publisher_fingerprint);
+
+  g_print ("3) PLAIN HTTP ENDPOINT\n");
+  check_ignored_endpoint (filename, EPC_PROTOCOL_HTTP,
+                          TEST_APPLICATION, NULL);
+
+  g_print ("4) UNKNOWN CERTIFICATE\n");
+  check_ignored_endpoint (filename, EPC_PROTOCOL_HTTPS,
+                          TEST_APPLICATION, NULL);
+
+  g_print ("5) DEAD ENDPOINT\n");
+  check_dead_endpoint (filename);
+
+  g_print ("6) MISMATCHED CERTIFICATE\n");
+  check_mismatched_endpoint (filename);
+
+  g_print ("X) DONE\n");
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  g_free (publisher_fingerprint);
+  g_unlink (filename);
+  g_free (filename);
+
+  return 0;
+}
@@ -0,0 +1,250 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+
+/* Test iterating listings page by page */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#include <string.h>
+
+/* More keys than fit into the publisher's default page. */
+#define TEST_KEY_COUNT 2500
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static gint publisher_port = 0;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static void
+check_cursor (EpcConsumer *consumer,
+              const gchar *pattern,
+              guint        page_size,
+              guint        first,
+              guint        count)
+{
+  GError *error = NULL;
+  EpcListCursor *cursor;
+  const gchar *key;
+  guint i = first;
+
+  cursor = epc_consumer_list_cursor_new (consumer, pattern, page_size);
+
+  while (NULL != (key = epc_list_cursor_next (cursor, &error)))
+    {
+      gchar *expected = g_strdup_printf ("key-%04u", i++);
+
+      if (strcmp (key, expected))
+        g_error ("%s: unexpected key `%s', expected `%s'", G_STRLOC, key, expected);
+
+      g_free (expected);
+    }
+
+  if (error)
+    g_error ("%s: %s", G_STRLOC, error->message);
+  if (i - first != count)
+    g_error ("%s: %u keys received, expected %u", G_STRLOC, i - first, count);
+
+  if (epc_list_cursor_next (cursor, &error) || error)
+    g_error ("%s: cursor didn't stop", G_STRLOC);
+
+  epc_list_cursor_free (cursor);
+}
+
+static void
+check_list (EpcConsumer *consumer)
+{
+  GError *error = NULL;
+  GList *keys;
+
+  /* Complete listings follow the publisher's continuations. */
+  keys = epc_consumer_list (consumer, NULL, &error);
+
+  if (error)
+    g_error ("%s: %s", G_STRLOC, error->message);
+  if (g_list_length (keys) != TEST_KEY_COUNT)
+    g_error ("%s: %u keys received, expected %u", G_STRLOC,
+             g_list_length (keys), TEST_KEY_COUNT);
+
+  g_list_foreach (keys, (GFunc) g_free, NULL);
+  g_list_free (keys);
+}
+
+static void
+check_page_limit (SoupSession *session,
+                  const gchar *accept,
+                  gboolean     complete)
+{
+  SoupMessage *request;
+  gchar *last_key;
+  gchar *uri;
+
+  uri = g_strdup_printf ("http://localhost:%d/list/", publisher_port);
+  request = soup_message_new (SOUP_METHOD_GET, uri);
+  g_free (uri);
+
+  if (accept)
+    soup_message_headers_replace (request->request_headers, "Accept", accept);
+
+  soup_session_send_message (session, request);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (request->status_code))
+    g_error ("%s: %s", G_STRLOC, request->reason_phrase);
+
+  last_key = g_strdup_printf ("key-%04u", TEST_KEY_COUNT - 1);
+
+  /* The compact format contains null characters, so only markup is searched. */
+  if (complete && !g_strstr_len (request->response_body->data,
+                                 request->response_body->length, last_key))
+    g_error ("%s: incomplete listing for `%s'", G_STRLOC, accept);
+  if (complete == (NULL != soup_message_headers_get_one (request->response_headers,
+                                                         "X-Epc-Continue")))
+    g_error ("%s: unexpected continuation for `%s'", G_STRLOC, accept);
+
+  g_object_unref (request);
+  g_free (last_key);
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  EpcConsumer *consumer;
+  SoupSession *session;
+  GThread *thread;
+  gchar *prgname;
+  guint i;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+
+  for (i = 0; i < TEST_KEY_COUNT; ++i)
+    {
+      gchar *key = g_strdup_printf ("key-%04u", i);
+      epc_publisher_add (publisher, key, key, -1);
+      g_free (key);
+    }
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           NULL);
+
+  g_print ("1) ALL KEYS\n");
+
+  check_cursor (consumer, NULL, 1, 0, TEST_KEY_COUNT);
+  check_cursor (consumer, NULL, 7, 0, TEST_KEY_COUNT);
+  check_cursor (consumer, NULL, TEST_KEY_COUNT, 0, TEST_KEY_COUNT);
+  check_cursor (consumer, NULL, TEST_KEY_COUNT * 2, 0, TEST_KEY_COUNT);
+
+  g_print ("2) MATCHING KEYS\n");
+
+  check_cursor (consumer, "key-05*", 7, 500, 100);
+  check_cursor (consumer, "key-0999", 7, 999, 1);
+  check_cursor (consumer, "nothing-*", 7, 0, 0);
+
+  g_print ("3) PAGE LIMITS\n");
+
+  session = soup_session_new ();
+
+  check_list (consumer);
+  check_page_limit (session, "application/x-epc-list", FALSE);
+  check_page_limit (session, NULL, TRUE);
+
+  g_object_unref (session);
+
+  g_print ("X) DONE\n");
+
+  g_object_unref (consumer);
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  return 0;
+}
@@ -0,0 +1,208 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test that patterns with reserved characters are matched by the publisher */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#include <string.h>
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static gint publisher_port = 0;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static gchar*
+join_keys (GList *keys)
+{
+  GString *joined = g_string_new (NULL);
+  GList *iter;
+
+  keys = g_list_sort (keys, (GCompareFunc) strcmp);
+
+  for (iter = keys; iter; iter = iter->next)
+    {
+      if (joined->len)
+        g_string_append_c (joined, ',');
+
+      g_string_append (joined, iter->data);
+    }
+
+  g_list_foreach (keys, (GFunc) g_free, NULL);
+  g_list_free (keys);
+
+  return g_string_free (joined, FALSE);
+}
+
+static void
+check_list (EpcConsumer *consumer,
+            const gchar *pattern,
+            const gchar *expected)
+{
+  GError *error = NULL;
+  GHashTable *values;
+  GList *keys;
+  gchar *joined;
+
+  keys = epc_consumer_list (consumer, pattern, &error);
+
+  if (error)
+    g_error ("%s: %s: %s", G_STRLOC, pattern, error->message);
+
+  joined = join_keys (keys);
+
+  if (strcmp (joined, expected))
+    g_error ("%s: %s: unexpected keys `%s', expected `%s'",
+             G_STRLOC, pattern, joined, expected);
+
+  g_free (joined);
+
+  values = epc_consumer_lookup_many (consumer, pattern, &error);
+
+  if (!values)
+    g_error ("%s: %s: %s", G_STRLOC, pattern, error->message);
+
+  joined = join_keys (g_list_copy_deep (g_hash_table_get_keys (values),
+                                        (GCopyFunc) g_strdup, NULL));
+
+  if (strcmp (joined, expected))
+    g_error ("%s: %s: unexpected values `%s', expected `%s'",
+             G_STRLOC, pattern, joined, expected);
+
+  g_hash_table_unref (values);
+  g_free (joined);
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  static const gchar *keys[] = { "a b", "a/b", "a?b", "axb", "b#1", "b#2", "b%", "c" };
+
+  EpcConsumer *consumer;
+  GThread *thread;
+  gchar *prgname;
+  guint i;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+
+  for (i = 0; i < G_N_ELEMENTS (keys); ++i)
+    epc_publisher_add (publisher, keys[i], keys[i], -1);
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           NULL);
+
+  g_print ("1) JOKERS\n");
+
+  check_list (consumer, "a?b", "a b,a/b,a?b,axb");
+  check_list (consumer, "b?", "b%");
+
+  g_print ("2) RESERVED CHARACTERS\n");
+
+  check_list (consumer, "a/*", "a/b");
+  check_list (consumer, "a b", "a b");
+  check_list (consumer, "b#*", "b#1,b#2");
+  check_list (consumer, "b%", "b%");
+
+  g_print ("3) NO MATCHES\n");
+
+  check_list (consumer, "d*", "");
+
+  g_print ("X) DONE\n");
+
+  g_object_unref (consumer);
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  return 0;
+}
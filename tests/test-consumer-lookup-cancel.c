@@ -0,0 +1,156 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test cancelling asynchronous lookups which wait for the publisher,
+ * from a thread running its own main context.
+ */
+
+#include "libepc/consumer.h"
+
+#include <gio/gio.h>
+
+typedef struct _TestLookup TestLookup;
+
+struct _TestLookup
+{
+  EpcConsumer  *consumer;
+  GMainContext *context;
+  GMainLoop    *loop;
+  GCancellable *cancellable;
+  GError       *error;
+  gboolean      timeout;
+};
+
+static GMainLoop *main_loop = NULL;
+
+static gboolean
+quit_main_loop_cb (gpointer data G_GNUC_UNUSED)
+{
+  g_main_loop_quit (main_loop);
+  return FALSE;
+}
+
+static gboolean
+cancel_cb (gpointer data)
+{
+  g_cancellable_cancel (data);
+  return FALSE;
+}
+
+static gboolean
+timeout_cb (gpointer data)
+{
+  TestLookup *lookup = data;
+
+  lookup->timeout = TRUE;
+  g_main_loop_quit (lookup->loop);
+
+  return FALSE;
+}
+
+static void
+lookup_ready_cb (GObject      *source G_GNUC_UNUSED,
+                 GAsyncResult *result,
+                 gpointer      data)
+{
+  TestLookup *lookup = data;
+  gpointer value;
+
+  if (g_main_context_get_thread_default () != lookup->context)
+    g_error ("%s: callback invoked in a foreign main context", G_STRLOC);
+
+  value = epc_consumer_lookup_finish (lookup->consumer, result, NULL, &lookup->error);
+  g_free (value);
+
+  g_main_loop_quit (lookup->loop);
+}
+
+static gpointer
+lookup_thread (gpointer data)
+{
+  TestLookup *lookup = data;
+  GSource *source;
+
+  g_main_context_push_thread_default (lookup->context);
+
+  epc_consumer_lookup_async (lookup->consumer, "maman", lookup->cancellable,
+                             lookup_ready_cb, lookup);
+
+  /* Cancel long before the consumer gives up on the publisher. */
+  source = g_timeout_source_new (100);
+  g_source_set_callback (source, cancel_cb, lookup->cancellable, NULL);
+  g_source_attach (source, lookup->context);
+  g_source_unref (source);
+
+  source = g_timeout_source_new (2000);
+  g_source_set_callback (source, timeout_cb, lookup, NULL);
+  g_source_attach (source, lookup->context);
+  g_source_unref (source);
+
+  g_main_loop_run (lookup->loop);
+  g_main_context_pop_thread_default (lookup->context);
+
+  g_idle_add (quit_main_loop_cb, NULL);
+
+  return NULL;
+}
+
+int
+main (void)
+{
+  TestLookup lookup = { NULL, };
+  GThread *thread;
+  gchar *name;
+  gint result = 1;
+
+  g_set_prgname (__FILE__);
+
+  /* The service monitor of the consumer runs in the default main context. */
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  name = g_strdup_printf ("%s: %08x", __FILE__, g_random_int ());
+  lookup.consumer = epc_consumer_new_for_name (name);
+  lookup.context = g_main_context_new ();
+  lookup.loop = g_main_loop_new (lookup.context, FALSE);
+  lookup.cancellable = g_cancellable_new ();
+
+  thread = g_thread_new ("lookup", lookup_thread, &lookup);
+  g_main_loop_run (main_loop);
+  g_thread_join (thread);
+
+  if (lookup.timeout)
+    g_warning ("%s: cancelled lookup didn't finish", G_STRLOC);
+  else if (!g_error_matches (lookup.error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_warning ("%s: unexpected result: %s", G_STRLOC,
+               lookup.error ? lookup.error->message : "success");
+  else
+    result = 0;
+
+  g_clear_error (&lookup.error);
+  g_object_unref (lookup.cancellable);
+  g_main_loop_unref (lookup.loop);
+  g_main_context_unref (lookup.context);
+  g_object_unref (lookup.consumer);
+  g_main_loop_unref (main_loop);
+  g_free (name);
+
+  return result;
+}
@@ -0,0 +1,285 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test retrieval of many values within one request */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#include <string.h>
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static gint publisher_port = 0;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static gboolean
+stream_read_cb (EpcContents *contents G_GNUC_UNUSED,
+                gpointer     buffer,
+                gsize       *length,
+                gpointer     user_data)
+{
+  gboolean *done = user_data;
+
+  if (*done)
+    {
+      *length = 0;
+      return FALSE;
+    }
+
+  if (!buffer)
+    return FALSE;
+
+  *done = TRUE;
+  *length = 6;
+  memcpy (buffer, "stream", 6);
+
+  return TRUE;
+}
+
+static EpcContents*
+stream_handler (EpcPublisher *publisher G_GNUC_UNUSED,
+                const gchar  *key G_GNUC_UNUSED,
+                gpointer      data G_GNUC_UNUSED)
+{
+  return epc_contents_stream_new (NULL, stream_read_cb, g_new0 (gboolean, 1), g_free);
+}
+
+static EpcContents*
+null_handler (EpcPublisher *publisher G_GNUC_UNUSED,
+              const gchar  *key G_GNUC_UNUSED,
+              gpointer      data G_GNUC_UNUSED)
+{
+  return NULL;
+}
+
+static gboolean
+auth_handler (EpcAuthContext *context,
+              const gchar    *username G_GNUC_UNUSED,
+              gpointer        data G_GNUC_UNUSED)
+{
+  return epc_auth_context_check_password (context, "secret");
+}
+
+static void
+check_value (GHashTable  *values,
+             const gchar *key,
+             const gchar *expected)
+{
+  GBytes *value = g_hash_table_lookup (values, key);
+
+  if (!expected && value)
+    g_error ("%s: %s: unexpected value", G_STRLOC, key);
+  if (expected && !value)
+    g_error ("%s: %s: value missing", G_STRLOC, key);
+
+  if (expected && (g_bytes_get_size (value) != strlen (expected) ||
+                   memcmp (g_bytes_get_data (value, NULL), expected, strlen (expected))))
+    g_error ("%s: %s: unexpected value", G_STRLOC, key);
+}
+
+static GHashTable*
+lookup_many (const gchar *password,
+             const gchar *pattern)
+{
+  GError *error = NULL;
+  EpcConsumer *consumer;
+  GHashTable *values;
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           "username", "user",
+                           "password", password,
+                           NULL);
+
+  values = epc_consumer_lookup_many (consumer, pattern, &error);
+
+  if (!values)
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  g_object_unref (consumer);
+
+  return values;
+}
+
+/* Clients without credentials must not be challenged,
+ * but just don't receive the protected keys. */
+static void
+check_anonymous (void)
+{
+  SoupSession *session;
+  SoupMessage *message;
+  gchar *uri;
+
+  uri = g_strdup_printf ("http://localhost:%d/batch", publisher_port);
+  session = soup_session_new ();
+  message = soup_message_new ("GET", uri);
+
+  soup_session_send_message (session, message);
+
+  if (SOUP_STATUS_OK != message->status_code)
+    g_error ("%s: unexpected status %d", G_STRLOC, message->status_code);
+  if (!message->response_body->data ||
+      !strstr (message->response_body->data, "first") ||
+      strstr (message->response_body->data, "hidden"))
+    g_error ("%s: unexpected response", G_STRLOC);
+
+  g_object_unref (message);
+  g_object_unref (session);
+  g_free (uri);
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  GHashTable *values;
+  GThread *thread;
+  gchar *prgname;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+  epc_publisher_add (publisher, "value-1", "first", -1);
+  epc_publisher_add (publisher, "value-2", "second", -1);
+  epc_publisher_add (publisher, "value/3", "", 0);
+  epc_publisher_add (publisher, "protected", "hidden", -1);
+  epc_publisher_add_handler (publisher, "stream", stream_handler, NULL, NULL);
+  epc_publisher_add_handler (publisher, "null", null_handler, NULL, NULL);
+  epc_publisher_set_auth_handler (publisher, "protected", auth_handler, NULL, NULL);
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  g_print ("1) ALL KEYS, WRONG PASSWORD\n");
+
+  values = lookup_many ("wrong", NULL);
+
+  check_value (values, "value-1", "first");
+  check_value (values, "value-2", "second");
+  check_value (values, "value/3", "");
+  check_value (values, "stream", "stream");
+  check_value (values, "protected", NULL);
+  check_value (values, "null", NULL);
+
+  if (4 != g_hash_table_size (values))
+    g_error ("%s: unexpected number of values", G_STRLOC);
+
+  g_hash_table_unref (values);
+
+  g_print ("2) ALL KEYS, RIGHT PASSWORD\n");
+
+  values = lookup_many ("secret", NULL);
+
+  check_value (values, "protected", "hidden");
+
+  if (5 != g_hash_table_size (values))
+    g_error ("%s: unexpected number of values", G_STRLOC);
+
+  g_hash_table_unref (values);
+
+  g_print ("3) MATCHING KEYS\n");
+
+  values = lookup_many (NULL, "value-*");
+
+  check_value (values, "value-1", "first");
+  check_value (values, "value-2", "second");
+
+  if (2 != g_hash_table_size (values))
+    g_error ("%s: unexpected number of values", G_STRLOC);
+
+  g_hash_table_unref (values);
+
+  g_print ("4) ANONYMOUS CLIENT\n");
+
+  check_anonymous ();
+
+  g_print ("X) DONE\n");
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  return 0;
+}
@@ -0,0 +1,242 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test retrieval of byte ranges */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static gint publisher_port = 0;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static gboolean
+stream_read_cb (EpcContents *contents G_GNUC_UNUSED,
+                gpointer     buffer,
+                gsize       *length,
+                gpointer     user_data)
+{
+  gint *chunk = user_data;
+
+  if (*chunk >= 2)
+    {
+      *length = 0;
+      return FALSE;
+    }
+
+  if (!buffer)
+    return FALSE;
+
+  /* Deliver the value in two chunks of five bytes. */
+  *length = 5;
+  memcpy (buffer, "0123456789" + 5 * (*chunk)++, 5);
+
+  return TRUE;
+}
+
+static EpcContents*
+stream_handler (EpcPublisher *publisher G_GNUC_UNUSED,
+                const gchar  *key G_GNUC_UNUSED,
+                gpointer      data G_GNUC_UNUSED)
+{
+  return epc_contents_stream_new (NULL, stream_read_cb, g_new0 (gint, 1), g_free);
+}
+
+static void
+check_range (EpcConsumer *consumer,
+             const gchar *key,
+             goffset      offset,
+             gssize       length,
+             const gchar *expected)
+{
+  GError *error = NULL;
+  gsize received = 0;
+  gchar *value;
+
+  value = epc_consumer_lookup_range (consumer, key, offset, length, &received, &error);
+
+  if (!value)
+    g_error ("%s: %s: %s", G_STRLOC, key, error->message);
+  if (received != strlen (expected) || memcmp (value, expected, received))
+    g_error ("%s: %s: unexpected value `%s' for range %d+%d",
+             G_STRLOC, key, value, (gint) offset, (gint) length);
+
+  g_free (value);
+}
+
+static void
+check_unsatisfiable (EpcConsumer *consumer,
+                     const gchar *key,
+                     goffset      offset)
+{
+  GError *error = NULL;
+  gchar *value;
+
+  value = epc_consumer_lookup_range (consumer, key, offset, 1, NULL, &error);
+
+  if (value)
+    g_error ("%s: %s: unexpected value `%s'", G_STRLOC, key, value);
+  if (!g_error_matches (error, EPC_HTTP_ERROR, SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE))
+    g_error ("%s: %s: %s", G_STRLOC, key, error ? error->message : "no error");
+
+  g_clear_error (&error);
+}
+
+static void
+check_key (EpcConsumer *consumer,
+           const gchar *key)
+{
+  check_range (consumer, key, 0, -1, "0123456789");
+  check_range (consumer, key, 0, 4, "0123");
+  check_range (consumer, key, 3, 4, "3456");
+  check_range (consumer, key, 6, -1, "6789");
+  check_range (consumer, key, 8, 10, "89");
+  check_range (consumer, key, 2, 0, "");
+
+  check_unsatisfiable (consumer, key, 10);
+  check_unsatisfiable (consumer, key, 1000);
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  gchar *filename = NULL;
+  GError *error = NULL;
+  EpcConsumer *consumer;
+  GThread *thread;
+  gchar *prgname;
+  gint fd;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  fd = g_file_open_tmp ("test-consumer-lookup-range-XXXXXX", &filename, &error);
+
+  if (fd < 0)
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  close (fd);
+
+  if (!g_file_set_contents (filename, "0123456789", -1, &error))
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+  epc_publisher_add (publisher, "value", "0123456789", -1);
+  epc_publisher_add_file (publisher, "file", filename);
+  epc_publisher_add_handler (publisher, "stream", stream_handler, NULL, NULL);
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           NULL);
+
+  g_print ("1) STATIC CONTENTS\n");
+  check_key (consumer, "value");
+
+  g_print ("2) FILES\n");
+  check_key (consumer, "file");
+
+  g_print ("3) STREAMS\n");
+  check_key (consumer, "stream");
+
+  g_print ("X) DONE\n");
+
+  g_object_unref (consumer);
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  g_unlink (filename);
+  g_free (filename);
+
+  return 0;
+}
@@ -0,0 +1,99 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test that consumers created one after another share service discovery,
+ * so that the second consumer finds the publisher without a new browser.
+ */
+
+#include "libepc/consumer.h"
+#include "libepc/publisher.h"
+
+#include "framework.h"
+
+int
+main (void)
+{
+  EpcPublisher *publisher = NULL;
+  EpcConsumer *consumer = NULL;
+  gboolean running = FALSE;
+  gchar *hostname = NULL;
+  GError *error = NULL;
+  gchar *value = NULL;
+  const gchar *name;
+  gint result = 1;
+  gint port = 0;
+
+  g_set_prgname (__FILE__);
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_test_goto_if_fail (EPC_IS_PUBLISHER (publisher), out);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+  epc_publisher_add (publisher, "maman", "bar", -1);
+
+  running = epc_publisher_run_async (publisher, &error);
+  epc_test_goto_if_fail (running, out);
+
+  name = epc_publisher_get_service_name (publisher);
+  epc_test_goto_if_fail (NULL != name, out);
+
+  /* The first consumer waits for service discovery. */
+  consumer = epc_consumer_new_for_name (name);
+  epc_test_goto_if_fail (EPC_IS_CONSUMER (consumer), out);
+
+  value = epc_consumer_lookup (consumer, "maman", NULL, &error);
+  epc_test_goto_if_fail (value && g_str_equal (value, "bar"), out);
+
+  g_object_unref (consumer);
+  g_free (value);
+  value = NULL;
+
+  /* The second consumer knows the publisher right after construction,
+   * before any main loop had a chance to run a new browser. */
+  consumer = epc_consumer_new_for_name (name);
+  epc_test_goto_if_fail (EPC_IS_CONSUMER (consumer), out);
+
+  g_object_get (consumer, "hostname", &hostname, "port", &port, NULL);
+  epc_test_goto_if_fail (NULL != hostname && port > 0, out);
+
+  value = epc_consumer_lookup (consumer, "maman", NULL, &error);
+  epc_test_goto_if_fail (value && g_str_equal (value, "bar"), out);
+
+  result = 0;
+
+out:
+  if (error)
+    g_warning ("%s: lookup failed: %s", G_STRLOC, error->message);
+
+  g_clear_error (&error);
+  g_free (hostname);
+  g_free (value);
+
+  if (consumer)
+    g_object_unref (consumer);
+
+  if (publisher)
+    {
+      epc_publisher_quit (publisher);
+      g_object_unref (publisher);
+    }
+
+  return result;
+}
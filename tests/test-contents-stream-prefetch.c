@@ -0,0 +1,291 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test reading streaming contents ahead of the consumer */
+
+#include <libepc/contents.h>
+#include <string.h>
+
+#define TEST_VALUE_LENGTH  (64 * 1024 + 123)
+#define TEST_CHUNK_LENGTH  1000
+
+static gchar test_value[TEST_VALUE_LENGTH];
+
+static GMutex test_gate_mutex;
+static GCond test_gate_cond;
+static guint test_gate_permits;
+static gboolean test_producer_blocked;
+static volatile gint test_destroyed;
+static GThread *test_main_thread;
+
+typedef struct _TestReader TestReader;
+
+struct _TestReader
+{
+  EpcContents *contents;
+  GMainLoop   *loop;
+  GString     *result;
+};
+
+static gboolean
+stream_read_cb (EpcContents *contents G_GNUC_UNUSED,
+                gpointer     buffer,
+                gsize       *length,
+                gpointer     user_data)
+{
+  gsize *offset = user_data;
+
+  if (!buffer)
+    return FALSE;
+
+  *length = MIN (*length, TEST_CHUNK_LENGTH);
+  *length = MIN (*length, TEST_VALUE_LENGTH - *offset);
+  memcpy (buffer, test_value + *offset, *length);
+  *offset += *length;
+
+  return *length > 0;
+}
+
+static gboolean
+blocking_read_cb (EpcContents *contents G_GNUC_UNUSED,
+                  gpointer     buffer,
+                  gsize       *length,
+                  gpointer     user_data G_GNUC_UNUSED)
+{
+  if (!buffer)
+    return FALSE;
+
+  g_mutex_lock (&test_gate_mutex);
+  test_producer_blocked = TRUE;
+  g_cond_broadcast (&test_gate_cond);
+
+  while (!test_gate_permits)
+    g_cond_wait (&test_gate_cond, &test_gate_mutex);
+
+  test_gate_permits -= 1;
+  test_producer_blocked = FALSE;
+  g_mutex_unlock (&test_gate_mutex);
+
+  *length = MIN (*length, TEST_CHUNK_LENGTH);
+  memset (buffer, 'X', *length);
+
+  return TRUE;
+}
+
+static void
+destroy_cb (gpointer data G_GNUC_UNUSED)
+{
+  /* The stream was read from the main thread,
+   * so it must be released there. */
+  if (g_thread_self () != test_main_thread)
+    g_error ("%s: stream released by a foreign thread", G_STRLOC);
+
+  g_atomic_int_set (&test_destroyed, 1);
+}
+
+static void
+read_ready_cb (GObject      *source G_GNUC_UNUSED,
+               GAsyncResult *result,
+               gpointer      data)
+{
+  TestReader *reader = data;
+  GError *error = NULL;
+  GBytes *chunk;
+
+  chunk = epc_contents_stream_read_bytes_finish (reader->contents, result, &error);
+
+  if (error)
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  if (!chunk)
+    {
+      g_main_loop_quit (reader->loop);
+      return;
+    }
+
+  g_string_append_len (reader->result,
+                       g_bytes_get_data (chunk, NULL),
+                       g_bytes_get_size (chunk));
+  g_bytes_unref (chunk);
+
+  epc_contents_stream_read_bytes_async (reader->contents, NULL,
+                                        read_ready_cb, reader);
+}
+
+static void
+check_stream (guint depth)
+{
+  EpcContents *contents;
+  GString *result;
+  GBytes *chunk;
+
+  contents = epc_contents_stream_new (NULL, stream_read_cb, g_new0 (gsize, 1), g_free);
+  epc_contents_stream_set_prefetch (contents, depth);
+
+  result = g_string_new (NULL);
+
+  while (NULL != (chunk = epc_contents_stream_read_bytes (contents)))
+    {
+      gsize length;
+      gconstpointer data = g_bytes_get_data (chunk, &length);
+
+      if (length > TEST_CHUNK_LENGTH)
+        g_error ("%s: chunk too large: %" G_GSIZE_FORMAT, G_STRLOC, length);
+
+      g_string_append_len (result, data, length);
+      g_bytes_unref (chunk);
+    }
+
+  if (result->len != TEST_VALUE_LENGTH ||
+      memcmp (result->str, test_value, TEST_VALUE_LENGTH))
+    g_error ("%s: unexpected contents for depth=%u", G_STRLOC, depth);
+
+  g_string_free (result, TRUE);
+  epc_contents_unref (contents);
+}
+
+static void
+check_abandoned_stream (void)
+{
+  EpcContents *contents;
+  GBytes *chunk;
+
+  /* Releasing a stream while its producer thread
+   * is still running must stop the thread. */
+  contents = epc_contents_stream_new (NULL, stream_read_cb, g_new0 (gsize, 1), g_free);
+  epc_contents_stream_set_prefetch (contents, 4);
+
+  chunk = epc_contents_stream_read_bytes (contents);
+
+  if (!chunk)
+    g_error ("%s: no data received", G_STRLOC);
+
+  g_bytes_unref (chunk);
+  epc_contents_unref (contents);
+}
+
+static void
+check_async_stream (guint depth)
+{
+  TestReader reader;
+
+  reader.contents = epc_contents_stream_new (NULL, stream_read_cb, g_new0 (gsize, 1), g_free);
+  reader.loop = g_main_loop_new (NULL, FALSE);
+  reader.result = g_string_new (NULL);
+
+  epc_contents_stream_set_prefetch (reader.contents, depth);
+  epc_contents_stream_read_bytes_async (reader.contents, NULL, read_ready_cb, &reader);
+  g_main_loop_run (reader.loop);
+
+  if (reader.result->len != TEST_VALUE_LENGTH ||
+      memcmp (reader.result->str, test_value, TEST_VALUE_LENGTH))
+    g_error ("%s: unexpected contents for depth=%u", G_STRLOC, depth);
+
+  g_string_free (reader.result, TRUE);
+  g_main_loop_unref (reader.loop);
+  epc_contents_unref (reader.contents);
+}
+
+static void
+check_blocked_producer (void)
+{
+  EpcContents *contents;
+  GBytes *chunk;
+  gint i;
+
+  /* Releasing a stream must not wait for a producer thread
+   * which is blocked in its callback. */
+  contents = epc_contents_stream_new (NULL, blocking_read_cb, NULL, destroy_cb);
+  epc_contents_stream_set_prefetch (contents, 1);
+
+  /* Only the first chunk gets produced, the producer
+   * blocks while reading the second chunk. */
+  g_mutex_lock (&test_gate_mutex);
+  test_gate_permits = 1;
+  g_mutex_unlock (&test_gate_mutex);
+
+  chunk = epc_contents_stream_read_bytes (contents);
+
+  if (!chunk)
+    g_error ("%s: no data received", G_STRLOC);
+
+  g_bytes_unref (chunk);
+
+  g_mutex_lock (&test_gate_mutex);
+
+  while (!test_producer_blocked)
+    g_cond_wait (&test_gate_cond, &test_gate_mutex);
+
+  g_mutex_unlock (&test_gate_mutex);
+
+  epc_contents_unref (contents);
+
+  if (g_atomic_int_get (&test_destroyed))
+    g_error ("%s: stream released before the producer returned", G_STRLOC);
+
+  /* The stream is released in the main context once the producer returns. */
+  g_mutex_lock (&test_gate_mutex);
+  test_gate_permits = G_MAXUINT;
+  g_cond_broadcast (&test_gate_cond);
+  g_mutex_unlock (&test_gate_mutex);
+
+  for (i = 0; i < 500 && !g_atomic_int_get (&test_destroyed); ++i)
+    if (!g_main_context_iteration (NULL, FALSE))
+      g_usleep (G_USEC_PER_SEC / 100);
+
+  if (!g_atomic_int_get (&test_destroyed))
+    g_error ("%s: stream not released by the producer thread", G_STRLOC);
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  gchar *prgname;
+  gint i;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  test_main_thread = g_thread_self ();
+
+  for (i = 0; i < TEST_VALUE_LENGTH; ++i)
+    test_value[i] = 'A' + i % 26;
+
+  g_print ("1) DIRECT READING\n");
+  check_stream (0);
+
+  g_print ("2) PRODUCER THREAD\n");
+  check_stream (1);
+  check_stream (4);
+  check_abandoned_stream ();
+  check_blocked_producer ();
+
+  g_print ("3) ASYNCHRONOUS READING\n");
+  check_async_stream (0);
+  check_async_stream (1);
+  check_async_stream (4);
+
+  g_print ("X) DONE\n");
+
+  return 0;
+}
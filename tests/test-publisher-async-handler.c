@@ -0,0 +1,256 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+
+/* Test that asynchronous contents handlers don't block each other */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#include <string.h>
+
+#define TEST_LOOKUP_COUNT  8
+#define TEST_HANDLER_DELAY (1000 * 1000)
+#define TEST_LISTENER_THREADS 2
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static GThread *publisher_gthread = NULL;
+static gint publisher_port = 0;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static gpointer
+worker_thread (gpointer data)
+{
+  EpcContentsRequest *request = data;
+  const gchar *key;
+
+  g_usleep (TEST_HANDLER_DELAY);
+
+  key = epc_contents_request_get_key (request);
+
+  if (g_str_equal (key, "missing"))
+    epc_contents_request_complete (request, NULL);
+  else
+    epc_contents_request_complete (request, epc_contents_new_dup ("text/plain", key, -1));
+
+  return NULL;
+}
+
+/* Requests are accepted by listener threads, but handlers
+ * not flagged as thread-safe must be called from the publisher's thread. */
+static void
+slow_handler (EpcPublisher       *publisher G_GNUC_UNUSED,
+              const gchar        *key G_GNUC_UNUSED,
+              EpcContentsRequest *request,
+              gpointer            data G_GNUC_UNUSED)
+{
+  if (g_thread_self () != publisher_gthread)
+    g_error ("%s: handler called from a listener thread", G_STRLOC);
+
+  g_thread_unref (g_thread_new ("worker", worker_thread, request));
+}
+
+static void
+immediate_handler (EpcPublisher       *publisher G_GNUC_UNUSED,
+                   const gchar        *key,
+                   EpcContentsRequest *request,
+                   gpointer            data G_GNUC_UNUSED)
+{
+  epc_contents_request_complete (request, epc_contents_new_dup ("text/plain", key, -1));
+}
+
+static gpointer
+consumer_thread (gpointer data)
+{
+  gboolean *found = data;
+  GError *error = NULL;
+  EpcConsumer *consumer;
+  gchar *value;
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           NULL);
+
+  value = epc_consumer_lookup (consumer, "slow", NULL, &error);
+  *found = (value && g_str_equal (value, "slow"));
+
+  if (error)
+    g_warning ("%s: %s", G_STRLOC, error->message);
+
+  g_clear_error (&error);
+  g_object_unref (consumer);
+  g_free (value);
+
+  return NULL;
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  GThread *consumers[TEST_LOOKUP_COUNT];
+  gboolean found[TEST_LOOKUP_COUNT];
+  GError *error = NULL;
+  EpcConsumer *consumer;
+  GThread *thread;
+  gchar *prgname;
+  GTimer *timer;
+  gchar *value;
+  gint i;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+  epc_publisher_set_listener_threads (publisher, TEST_LISTENER_THREADS);
+  epc_publisher_add_async_handler (publisher, "slow", slow_handler, NULL, NULL);
+  epc_publisher_add_async_handler (publisher, "missing", slow_handler, NULL, NULL);
+  epc_publisher_add_async_handler (publisher, "immediate", immediate_handler, NULL, NULL);
+  epc_publisher_set_handler_flags (publisher, "immediate", EPC_HANDLER_THREAD_SAFE);
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+  publisher_gthread = thread;
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           NULL);
+
+  g_print ("1) IMMEDIATE COMPLETION\n");
+
+  value = epc_consumer_lookup (consumer, "immediate", NULL, &error);
+
+  if (!value)
+    g_error ("%s: %s", G_STRLOC, error->message);
+  if (strcmp (value, "immediate"))
+    g_error ("%s: unexpected value `%s'", G_STRLOC, value);
+
+  g_free (value);
+
+  g_print ("2) MISSING CONTENTS\n");
+
+  value = epc_consumer_lookup (consumer, "missing", NULL, &error);
+
+  if (value)
+    g_error ("%s: unexpected value `%s'", G_STRLOC, value);
+  if (!g_error_matches (error, EPC_HTTP_ERROR, SOUP_STATUS_NOT_FOUND))
+    g_error ("%s: %s", G_STRLOC, error ? error->message : "no error");
+
+  g_clear_error (&error);
+
+  g_print ("3) CONCURRENT REQUESTS\n");
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < TEST_LOOKUP_COUNT; ++i)
+    consumers[i] = g_thread_new ("consumer", consumer_thread, &found[i]);
+  for (i = 0; i < TEST_LOOKUP_COUNT; ++i)
+    g_thread_join (consumers[i]);
+
+  g_timer_stop (timer);
+
+  g_print ("%s: %d lookups took %.2f seconds\n", G_STRLOC,
+           TEST_LOOKUP_COUNT, g_timer_elapsed (timer, NULL));
+
+  for (i = 0; i < TEST_LOOKUP_COUNT; ++i)
+    if (!found[i])
+      g_error ("%s: lookup %d failed", G_STRLOC, i);
+
+  if (g_timer_elapsed (timer, NULL) >= 2e-6 * TEST_HANDLER_DELAY)
+    g_error ("%s: requests were serialized", G_STRLOC);
+
+  g_timer_destroy (timer);
+
+  g_print ("X) DONE\n");
+
+  g_object_unref (consumer);
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  return 0;
+}
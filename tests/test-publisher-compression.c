@@ -0,0 +1,255 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+
+/* Test negotiation of compressed responses */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#include <string.h>
+
+#define TEST_VALUE_LENGTH (64 * 1024)
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static gint publisher_port = 0;
+static gchar *test_value = NULL;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static gboolean
+stream_read_cb (EpcContents *contents G_GNUC_UNUSED,
+                gpointer     buffer,
+                gsize       *length,
+                gpointer     user_data)
+{
+  gsize *offset = user_data;
+
+  if (!buffer)
+    return FALSE;
+
+  *length = MIN (*length, TEST_VALUE_LENGTH - *offset);
+  memcpy (buffer, test_value + *offset, *length);
+  *offset += *length;
+
+  return *length > 0;
+}
+
+static EpcContents*
+stream_handler (EpcPublisher *publisher G_GNUC_UNUSED,
+                const gchar  *key G_GNUC_UNUSED,
+                gpointer      data G_GNUC_UNUSED)
+{
+  return epc_contents_stream_new ("text/plain", stream_read_cb, g_new0 (gsize, 1), g_free);
+}
+
+/* Handler output isn't cached, so it must not be compressed as a whole. */
+static EpcContents*
+dynamic_handler (EpcPublisher *publisher G_GNUC_UNUSED,
+                 const gchar  *key G_GNUC_UNUSED,
+                 gpointer      data G_GNUC_UNUSED)
+{
+  return epc_contents_new_dup ("text/plain", test_value, TEST_VALUE_LENGTH);
+}
+
+static void
+check_encoding (SoupSession *session,
+                const gchar *key,
+                const gchar *accept,
+                const gchar *expected)
+{
+  const gchar *encoding;
+  SoupMessage *request;
+  gchar *uri;
+
+  uri = g_strdup_printf ("http://localhost:%d/contents/%s", publisher_port, key);
+  request = soup_message_new (SOUP_METHOD_GET, uri);
+  g_free (uri);
+
+  if (accept)
+    soup_message_headers_replace (request->request_headers, "Accept-Encoding", accept);
+
+  soup_session_send_message (session, request);
+
+  if (!SOUP_STATUS_IS_SUCCESSFUL (request->status_code))
+    g_error ("%s: %s: %s", G_STRLOC, key, request->reason_phrase);
+
+  encoding = soup_message_headers_get_one (request->response_headers, "Content-Encoding");
+
+  if (g_strcmp0 (encoding, expected))
+    g_error ("%s: %s: unexpected encoding `%s'", G_STRLOC, key, encoding);
+  if (expected && request->response_body->length >= TEST_VALUE_LENGTH)
+    g_error ("%s: %s: response not compressed", G_STRLOC, key);
+  if (!expected && request->response_body->length != TEST_VALUE_LENGTH)
+    g_error ("%s: %s: unexpected response length", G_STRLOC, key);
+
+  g_object_unref (request);
+}
+
+static void
+check_lookup (EpcConsumer *consumer,
+              const gchar *key)
+{
+  GError *error = NULL;
+  gsize length = 0;
+  gchar *value;
+
+  value = epc_consumer_lookup (consumer, key, &length, &error);
+
+  if (!value)
+    g_error ("%s: %s: %s", G_STRLOC, key, error->message);
+  if (length != TEST_VALUE_LENGTH || memcmp (value, test_value, length))
+    g_error ("%s: %s: unexpected value", G_STRLOC, key);
+
+  g_free (value);
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  EpcConsumer *consumer;
+  SoupSession *session;
+  GThread *thread;
+  gchar *prgname;
+  gint i;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  test_value = g_malloc (TEST_VALUE_LENGTH);
+
+  for (i = 0; i < TEST_VALUE_LENGTH; ++i)
+    test_value[i] = 'a' + i % 26;
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+  epc_publisher_add (publisher, "static", test_value, TEST_VALUE_LENGTH);
+  epc_publisher_add_handler (publisher, "stream", stream_handler, NULL, NULL);
+  epc_publisher_add_handler (publisher, "dynamic", dynamic_handler, NULL, NULL);
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  session = soup_session_new_with_options (SOUP_SESSION_REMOVE_FEATURE_BY_TYPE,
+                                           SOUP_TYPE_CONTENT_DECODER, NULL);
+
+  g_print ("1) STATIC CONTENTS\n");
+
+  check_encoding (session, "static", NULL, NULL);
+  check_encoding (session, "static", "identity", NULL);
+  check_encoding (session, "static", "gzip", "gzip");
+  check_encoding (session, "static", "deflate", "deflate");
+  check_encoding (session, "static", "deflate, gzip;q=0.5", "deflate");
+
+  g_print ("2) STREAMS\n");
+
+  check_encoding (session, "stream", NULL, NULL);
+  check_encoding (session, "stream", "gzip", "gzip");
+
+  g_print ("3) HANDLER OUTPUT\n");
+
+  check_encoding (session, "dynamic", "gzip", NULL);
+
+  g_print ("4) TRANSPARENT DECODING\n");
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           NULL);
+
+  check_lookup (consumer, "static");
+  check_lookup (consumer, "stream");
+  check_lookup (consumer, "dynamic");
+
+  g_print ("X) DONE\n");
+
+  g_object_unref (consumer);
+  g_object_unref (session);
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  g_free (test_value);
+
+  return 0;
+}
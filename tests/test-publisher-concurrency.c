@@ -0,0 +1,219 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test that slow contents handlers of publishers running in different
+ * threads don't serialize each other */
+
+#include "framework.h"
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#define TEST_PUBLISHER_COUNT  4
+#define TEST_HANDLER_DELAY    (1000 * 1000)
+
+typedef struct _TestPublisher TestPublisher;
+
+struct _TestPublisher
+{
+  GThread      *thread;
+  GMainContext *context;
+  GMainLoop    *loop;
+  EpcPublisher *publisher;
+  gint          port;
+  gboolean      started;
+  gboolean      found;
+};
+
+static TestPublisher test_publishers[TEST_PUBLISHER_COUNT];
+static GMutex test_mutex;
+static GCond test_cond;
+
+static EpcContents*
+slow_handler (EpcPublisher *publisher G_GNUC_UNUSED,
+              const gchar  *key,
+              gpointer      data G_GNUC_UNUSED)
+{
+  g_usleep (TEST_HANDLER_DELAY);
+  return epc_contents_new_dup ("text/plain", key, -1);
+}
+
+static gpointer
+publisher_thread (gpointer data)
+{
+  TestPublisher *test = data;
+  GError *error = NULL;
+  gchar *name, *uri;
+  SoupURI *parsed;
+
+  g_main_context_push_thread_default (test->context);
+
+  name = g_strdup_printf ("%s %x", __FILE__, g_random_int ());
+  test->publisher = epc_publisher_new (name, NULL, NULL);
+  g_free (name);
+
+  epc_publisher_set_protocol (test->publisher, EPC_PROTOCOL_HTTP);
+  epc_publisher_add_handler (test->publisher, "slow", slow_handler, NULL, NULL);
+
+  if (epc_publisher_run_async (test->publisher, &error))
+    {
+      uri = epc_publisher_get_uri (test->publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      test->port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test->started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (test->port > 0)
+    g_main_loop_run (test->loop);
+
+  g_object_unref (test->publisher);
+  g_main_context_pop_thread_default (test->context);
+
+  return NULL;
+}
+
+static gpointer
+consumer_thread (gpointer data)
+{
+  TestPublisher *test = data;
+  GError *error = NULL;
+  EpcConsumer *consumer;
+  gchar *value;
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", test->port,
+                           NULL);
+
+  value = epc_consumer_lookup (consumer, "slow", NULL, &error);
+  test->found = (value && g_str_equal (value, "slow"));
+
+  if (error)
+    g_warning ("%s: %s", G_STRLOC, error->message);
+
+  g_clear_error (&error);
+  g_object_unref (consumer);
+  g_free (value);
+
+  return NULL;
+}
+
+static gboolean
+lookup_cb (gpointer data G_GNUC_UNUSED)
+{
+  GThread *consumers[TEST_PUBLISHER_COUNT];
+  gboolean found = TRUE;
+  GTimer *timer;
+  gint i;
+
+  timer = g_timer_new ();
+
+  for (i = 0; i < TEST_PUBLISHER_COUNT; ++i)
+    consumers[i] = g_thread_new ("consumer", consumer_thread, &test_publishers[i]);
+  for (i = 0; i < TEST_PUBLISHER_COUNT; ++i)
+    g_thread_join (consumers[i]);
+
+  g_timer_stop (timer);
+
+  for (i = 0; i < TEST_PUBLISHER_COUNT; ++i)
+    found = found && test_publishers[i].found;
+
+  g_print ("%s: %d lookups took %.2f seconds\n", G_STRLOC,
+           TEST_PUBLISHER_COUNT, g_timer_elapsed (timer, NULL));
+
+  if (found)
+    epc_test_pass_once (1 << 1);
+  if (found && g_timer_elapsed (timer, NULL) < 2e-6 * TEST_HANDLER_DELAY)
+    epc_test_pass_once (1 << 2);
+
+  g_timer_destroy (timer);
+
+  return FALSE;
+}
+
+int
+main (void)
+{
+  gboolean started = TRUE;
+  gint result = 1;
+  gint i;
+
+  g_set_prgname (__FILE__);
+
+  if (!epc_test_init (3))
+    return result;
+
+  for (i = 0; i < TEST_PUBLISHER_COUNT; ++i)
+    {
+      TestPublisher *test = &test_publishers[i];
+
+      test->context = g_main_context_new ();
+      test->loop = g_main_loop_new (test->context, FALSE);
+
+      /* Start publishers one by one, as the Avahi client
+       * isn't attached to the main loop before epc_test_run(). */
+
+      g_mutex_lock (&test_mutex);
+      test->thread = g_thread_new ("publisher", publisher_thread, test);
+
+      while (!test->started)
+        g_cond_wait (&test_cond, &test_mutex);
+
+      g_mutex_unlock (&test_mutex);
+
+      started = started && test->port > 0;
+    }
+
+  if (started)
+    {
+      epc_test_pass_once (1 << 0);
+      g_idle_add (lookup_cb, NULL);
+      result = epc_test_run ();
+    }
+  else
+    result = epc_test_quit ();
+
+  for (i = 0; i < TEST_PUBLISHER_COUNT; ++i)
+    {
+      g_main_loop_quit (test_publishers[i].loop);
+      g_thread_join (test_publishers[i].thread);
+
+      g_main_loop_unref (test_publishers[i].loop);
+      g_main_context_unref (test_publishers[i].context);
+    }
+
+  return result;
+}
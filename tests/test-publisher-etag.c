@@ -0,0 +1,260 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test conditional requests using entity tags */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static gint publisher_port = 0;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static EpcContents*
+tagged_handler (EpcPublisher *self G_GNUC_UNUSED,
+                const gchar  *key G_GNUC_UNUSED,
+                gpointer      data G_GNUC_UNUSED)
+{
+  EpcContents *contents = epc_contents_new_dup ("text/plain", "tagged", -1);
+  epc_contents_set_etag (contents, "version-1");
+  return contents;
+}
+
+static EpcContents*
+untagged_handler (EpcPublisher *self G_GNUC_UNUSED,
+                  const gchar  *key G_GNUC_UNUSED,
+                  gpointer      data G_GNUC_UNUSED)
+{
+  return epc_contents_new_dup ("text/plain", "untagged", -1);
+}
+
+/* Buffers built for each request are not checksummed,
+ * unless the client sends a validator. */
+static void
+check_untagged (EpcConsumer *consumer,
+                const gchar *key,
+                const gchar *expected)
+{
+  GError *error = NULL;
+  gchar *etag = NULL;
+  gchar *value;
+
+  value = epc_consumer_revalidate (consumer, key, &etag, NULL, &error);
+
+  if (!value)
+    g_error ("%s: %s: %s", G_STRLOC, key, error->message);
+  if (strcmp (value, expected))
+    g_error ("%s: %s: unexpected value `%s'", G_STRLOC, key, value);
+  if (etag)
+    g_error ("%s: %s: unexpected entity tag `%s'", G_STRLOC, key, etag);
+
+  g_free (value);
+}
+
+static void
+check_changed (EpcConsumer *consumer,
+               const gchar *key,
+               gchar      **etag,
+               const gchar *expected)
+{
+  GError *error = NULL;
+  gchar *value;
+
+  value = epc_consumer_revalidate (consumer, key, etag, NULL, &error);
+
+  if (!value)
+    g_error ("%s: %s: %s", G_STRLOC, key, error->message);
+  if (strcmp (value, expected))
+    g_error ("%s: %s: unexpected value `%s'", G_STRLOC, key, value);
+  if (!*etag)
+    g_error ("%s: %s: no entity tag received", G_STRLOC, key);
+
+  g_free (value);
+}
+
+static void
+check_unchanged (EpcConsumer *consumer,
+                 const gchar *key,
+                 gchar      **etag)
+{
+  GError *error = NULL;
+  gchar *value;
+
+  value = epc_consumer_revalidate (consumer, key, etag, NULL, &error);
+
+  if (value)
+    g_error ("%s: %s: unexpected value `%s'", G_STRLOC, key, value);
+  if (!g_error_matches (error, EPC_HTTP_ERROR, SOUP_STATUS_NOT_MODIFIED))
+    g_error ("%s: %s: %s", G_STRLOC, key, error ? error->message : "no error");
+
+  g_clear_error (&error);
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  gchar *value_etag = NULL;
+  gchar *file_etag = NULL;
+  gchar *tagged_etag = NULL;
+  gchar *filename = NULL;
+  GError *error = NULL;
+  EpcConsumer *consumer;
+  GThread *thread;
+  gchar *prgname;
+  gint fd;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  fd = g_file_open_tmp ("test-publisher-etag-XXXXXX", &filename, &error);
+
+  if (fd < 0)
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  close (fd);
+
+  if (!g_file_set_contents (filename, "first", -1, &error))
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+  epc_publisher_add (publisher, "value", "first", -1);
+  epc_publisher_add_file (publisher, "file", filename);
+  epc_publisher_add_handler (publisher, "tagged", tagged_handler, NULL, NULL);
+  epc_publisher_add_handler (publisher, "untagged", untagged_handler, NULL, NULL);
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           NULL);
+
+  g_print ("1) STATIC CONTENTS\n");
+
+  check_changed (consumer, "value", &value_etag, "first");
+  check_unchanged (consumer, "value", &value_etag);
+
+  epc_publisher_add (publisher, "value", "second", -1);
+
+  check_changed (consumer, "value", &value_etag, "second");
+  check_unchanged (consumer, "value", &value_etag);
+
+  g_print ("2) FILES\n");
+
+  check_changed (consumer, "file", &file_etag, "first");
+  check_unchanged (consumer, "file", &file_etag);
+
+  if (!g_file_set_contents (filename, "modified", -1, &error))
+    g_error ("%s: %s", G_STRLOC, error->message);
+
+  check_changed (consumer, "file", &file_etag, "modified");
+  check_unchanged (consumer, "file", &file_etag);
+
+  g_print ("3) HANDLERS\n");
+
+  check_changed (consumer, "tagged", &tagged_etag, "tagged");
+  check_unchanged (consumer, "tagged", &tagged_etag);
+  check_untagged (consumer, "untagged", "untagged");
+
+  g_print ("X) DONE\n");
+
+  g_object_unref (consumer);
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  g_unlink (filename);
+  g_free (filename);
+  g_free (value_etag);
+  g_free (file_etag);
+  g_free (tagged_etag);
+
+  return 0;
+}
@@ -0,0 +1,215 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test running thread-safe contents handlers in the publisher's thread pool */
+
+#include <libepc/consumer.h>
+#include <libepc/publisher.h>
+#include <libsoup/soup.h>
+
+#include <string.h>
+
+#define TEST_HANDLER_THREADS    2
+
+static GMainContext *publisher_context = NULL;
+static GMainLoop *publisher_loop = NULL;
+static EpcPublisher *publisher = NULL;
+static GThread *publisher_gthread = NULL;
+static gint publisher_port = 0;
+
+static GMutex test_mutex;
+static GCond test_cond;
+static gboolean test_started = FALSE;
+static guint test_active_handlers = 0;
+
+/* Thread-safe handlers run in the thread pool. Each call waits for
+ * the other one, which only succeeds when both run at the same time. */
+static EpcContents*
+safe_handler (EpcPublisher *self G_GNUC_UNUSED,
+              const gchar  *key G_GNUC_UNUSED,
+              gpointer      data G_GNUC_UNUSED)
+{
+  gint64 deadline = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;
+
+  if (g_thread_self () == publisher_gthread)
+    g_error ("%s: thread-safe handler called from the publisher's thread", G_STRLOC);
+
+  g_mutex_lock (&test_mutex);
+
+  test_active_handlers += 1;
+  g_cond_broadcast (&test_cond);
+
+  while (test_active_handlers < TEST_HANDLER_THREADS)
+    if (!g_cond_wait_until (&test_cond, &test_mutex, deadline))
+      g_error ("%s: thread-safe handlers not run concurrently", G_STRLOC);
+
+  g_mutex_unlock (&test_mutex);
+
+  return epc_contents_new_dup ("text/plain", "safe", -1);
+}
+
+/* Other handlers must be called from the publisher's thread. */
+static EpcContents*
+unsafe_handler (EpcPublisher *self G_GNUC_UNUSED,
+                const gchar  *key G_GNUC_UNUSED,
+                gpointer      data G_GNUC_UNUSED)
+{
+  if (g_thread_self () != publisher_gthread)
+    g_error ("%s: handler called from a pool thread", G_STRLOC);
+
+  return epc_contents_new_dup ("text/plain", "unsafe", -1);
+}
+
+static void
+consumer_expect (EpcConsumer *consumer,
+                 const gchar *key,
+                 const gchar *expected)
+{
+  GError *error = NULL;
+  gchar *value;
+
+  value = epc_consumer_lookup (consumer, key, NULL, &error);
+
+  if (!value)
+    g_error ("%s: %s", G_STRLOC, error->message);
+  if (strcmp (value, expected))
+    g_error ("%s: unexpected value `%s'", G_STRLOC, value);
+
+  g_free (value);
+}
+
+static gpointer
+publisher_thread (gpointer data G_GNUC_UNUSED)
+{
+  GError *error = NULL;
+  gchar *uri;
+
+  g_main_context_push_thread_default (publisher_context);
+
+  if (epc_publisher_run_async (publisher, &error))
+    {
+      SoupURI *parsed;
+
+      uri = epc_publisher_get_uri (publisher, NULL, NULL);
+      parsed = soup_uri_new (uri);
+
+      publisher_port = parsed->port;
+
+      soup_uri_free (parsed);
+      g_free (uri);
+    }
+  else
+    {
+      g_warning ("%s: %s", G_STRLOC, error->message);
+      g_clear_error (&error);
+    }
+
+  g_mutex_lock (&test_mutex);
+  test_started = TRUE;
+  g_cond_signal (&test_cond);
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port > 0)
+    g_main_loop_run (publisher_loop);
+
+  g_main_context_pop_thread_default (publisher_context);
+
+  return NULL;
+}
+
+static gpointer
+consumer_thread (gpointer data G_GNUC_UNUSED)
+{
+  EpcConsumer *consumer;
+
+  consumer = g_object_new (EPC_TYPE_CONSUMER,
+                           "protocol", EPC_PROTOCOL_HTTP,
+                           "hostname", "localhost",
+                           "port", publisher_port,
+                           NULL);
+
+  consumer_expect (consumer, "safe", "safe");
+  consumer_expect (consumer, "unsafe", "unsafe");
+
+  g_object_unref (consumer);
+
+  return NULL;
+}
+
+int
+main (int   argc G_GNUC_UNUSED,
+      char *argv[])
+{
+  GThread *consumers[TEST_HANDLER_THREADS];
+  GThread *thread;
+  gchar *prgname;
+  gint i;
+
+  prgname = g_path_get_basename (argv[0]);
+  g_set_prgname (prgname);
+  g_free (prgname);
+
+  publisher = epc_publisher_new (NULL, NULL, NULL);
+  epc_publisher_set_protocol (publisher, EPC_PROTOCOL_HTTP);
+  epc_publisher_set_handler_threads (publisher, TEST_HANDLER_THREADS);
+
+  epc_publisher_add_handler (publisher, "safe", safe_handler, NULL, NULL);
+  epc_publisher_set_handler_flags (publisher, "safe", EPC_HANDLER_THREAD_SAFE);
+  epc_publisher_add_handler (publisher, "unsafe", unsafe_handler, NULL, NULL);
+
+  if (TEST_HANDLER_THREADS != epc_publisher_get_handler_threads (publisher))
+    g_error ("%s: handler threads not set", G_STRLOC);
+  if (EPC_HANDLER_THREAD_SAFE != epc_publisher_get_handler_flags (publisher, "safe"))
+    g_error ("%s: handler flags not set", G_STRLOC);
+  if (EPC_HANDLER_DEFAULT != epc_publisher_get_handler_flags (publisher, "unsafe"))
+    g_error ("%s: unexpected handler flags", G_STRLOC);
+
+  publisher_context = g_main_context_new ();
+  publisher_loop = g_main_loop_new (publisher_context, FALSE);
+
+  g_mutex_lock (&test_mutex);
+  thread = g_thread_new ("publisher", publisher_thread, NULL);
+  publisher_gthread = thread;
+
+  while (!test_started)
+    g_cond_wait (&test_cond, &test_mutex);
+
+  g_mutex_unlock (&test_mutex);
+
+  if (publisher_port <= 0)
+    g_error ("%s: publisher didn't start", G_STRLOC);
+
+  for (i = 0; i < TEST_HANDLER_THREADS; ++i)
+    consumers[i] = g_thread_new ("consumer", consumer_thread, NULL);
+  for (i = 0; i < TEST_HANDLER_THREADS; ++i)
+    g_thread_join (consumers[i]);
+
+  g_print ("X) DONE\n");
+
+  g_main_loop_quit (publisher_loop);
+  g_thread_join (thread);
+
+  g_object_unref (publisher);
+  g_main_loop_unref (publisher_loop);
+  g_main_context_unref (publisher_context);
+
+  return 0;
+}
@@ -0,0 +1,206 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test querying the directory of resolved services */
+
+#include "framework.h"
+#include "libepc/dispatcher.h"
+#include "libepc/service-monitor.h"
+
+static gchar *test_type = NULL;
+static gchar *first_name = NULL;
+static gchar *second_name = NULL;
+
+static EpcDispatcher *second_dispatcher = NULL;
+static gboolean first_found = FALSE;
+static gboolean second_found = FALSE;
+
+static void
+count_cb (EpcServiceMonitor *monitor G_GNUC_UNUSED,
+          const gchar       *name,
+          EpcServiceInfo    *info,
+          gpointer           data)
+{
+  guint *count = data;
+
+  if (!name || !info)
+    g_error ("%s: incomplete directory entry", G_STRLOC);
+
+  *count += 1;
+}
+
+static guint
+count_services (EpcServiceMonitor *monitor,
+                const gchar       *name)
+{
+  guint count = 0;
+
+  epc_service_monitor_foreach (monitor, name, count_cb, &count);
+
+  return count;
+}
+
+static void
+check_lookup (EpcServiceMonitor *monitor,
+              const gchar       *name,
+              guint              port)
+{
+  EpcServiceInfo *info;
+
+  info = epc_service_monitor_lookup (monitor, name, test_type, NULL);
+
+  if (!info)
+    g_error ("%s: `%s' not found in the directory", G_STRLOC, name);
+  if (epc_service_info_get_port (info) != port)
+    g_error ("%s: unexpected port for `%s'", G_STRLOC, name);
+
+  epc_service_info_unref (info);
+
+  info = epc_service_monitor_lookup (monitor, name, "_unknown._tcp", NULL);
+
+  if (info)
+    g_error ("%s: `%s' found for the wrong service type", G_STRLOC, name);
+}
+
+static void
+service_found_cb (EpcServiceMonitor *monitor,
+                  const gchar       *name,
+                  EpcServiceInfo    *info G_GNUC_UNUSED,
+                  gpointer           data G_GNUC_UNUSED)
+{
+  guint first_count, second_count;
+
+  if (g_str_equal (name, first_name))
+    {
+      check_lookup (monitor, name, 2007);
+      first_found = TRUE;
+    }
+
+  if (g_str_equal (name, second_name))
+    {
+      check_lookup (monitor, name, 2008);
+      second_found = TRUE;
+    }
+
+  if (epc_service_monitor_lookup (monitor, "no such service", NULL, NULL))
+    g_error ("%s: unknown service found", G_STRLOC);
+
+  /* The monitor only watches the services of this test. */
+  first_count = count_services (monitor, first_name);
+  second_count = count_services (monitor, second_name);
+
+  if (first_count + second_count != count_services (monitor, NULL) ||
+      first_count + second_count != epc_service_monitor_get_n_services (monitor))
+    g_error ("%s: inconsistent directory", G_STRLOC);
+
+  if (first_found && second_found && second_dispatcher)
+    {
+      epc_test_pass_once (1 << 0);
+
+      /* Withdrawn services must leave the directory. */
+      g_object_unref (second_dispatcher);
+      second_dispatcher = NULL;
+    }
+}
+
+static void
+service_removed_cb (EpcServiceMonitor *monitor,
+                    const gchar       *name,
+                    const gchar       *type G_GNUC_UNUSED,
+                    gpointer           data G_GNUC_UNUSED)
+{
+  EpcServiceInfo *info;
+
+  if (!g_str_equal (name, second_name))
+    return;
+
+  /* The service might be announced on several interfaces. */
+  info = epc_service_monitor_lookup (monitor, name, NULL, NULL);
+
+  if (info)
+    {
+      epc_service_info_unref (info);
+      return;
+    }
+
+  if (count_services (monitor, second_name) ||
+      count_services (monitor, NULL) != epc_service_monitor_get_n_services (monitor))
+    g_error ("%s: inconsistent directory", G_STRLOC);
+
+  epc_test_pass_many (1 << 1);
+}
+
+int
+main (void)
+{
+  EpcDispatcher *first_dispatcher = NULL;
+  EpcServiceMonitor *monitor = NULL;
+  gint result = EPC_TEST_MASK_ALL;
+  GError *error = NULL;
+
+  test_type = g_strdup_printf ("_test-%08x._tcp", g_random_int ());
+  first_name = g_strdup_printf ("%s: %08x-1", __FILE__, g_random_int ());
+  second_name = g_strdup_printf ("%s: %08x-2", __FILE__, g_random_int ());
+
+  first_dispatcher = epc_dispatcher_new (first_name);
+  second_dispatcher = epc_dispatcher_new (second_name);
+
+  if (!epc_test_init (2) ||
+      !epc_dispatcher_run (first_dispatcher, &error) ||
+      !epc_dispatcher_run (second_dispatcher, &error))
+    goto out;
+
+  monitor = epc_service_monitor_new_for_types (NULL, test_type, NULL);
+
+  if (epc_service_monitor_get_n_services (monitor))
+    g_error ("%s: directory not empty", G_STRLOC);
+
+  g_signal_connect (monitor, "service-found",
+                    G_CALLBACK (service_found_cb), NULL);
+  g_signal_connect (monitor, "service-removed",
+                    G_CALLBACK (service_removed_cb), NULL);
+
+  epc_dispatcher_add_service (first_dispatcher, EPC_ADDRESS_UNSPEC,
+                              test_type, NULL, NULL, 2007, NULL);
+  epc_dispatcher_add_service (second_dispatcher, EPC_ADDRESS_UNSPEC,
+                              test_type, NULL, NULL, 2008, NULL);
+
+  result = epc_test_run ();
+
+out:
+  if (error)
+    g_print ("%s: %s\n", G_STRLOC, error->message);
+
+  g_clear_error (&error);
+
+  if (monitor)
+    g_object_unref (monitor);
+  if (second_dispatcher)
+    g_object_unref (second_dispatcher);
+  if (first_dispatcher)
+    g_object_unref (first_dispatcher);
+
+  g_free (second_name);
+  g_free (first_name);
+  g_free (test_type);
+
+  return result;
+}
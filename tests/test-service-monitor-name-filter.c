@@ -0,0 +1,127 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test that services are only resolved when matching the name filter */
+
+#include "framework.h"
+#include "libepc/dispatcher.h"
+#include "libepc/service-monitor.h"
+
+static gchar *test_type = NULL;
+static gchar *first_name = NULL;
+static gchar *second_name = NULL;
+
+static GThread *filter_thread = NULL;
+static gint filter_extended = FALSE;
+
+/* Consumers change the filter from their own threads. */
+static gpointer
+extend_filter_thread (gpointer data)
+{
+  gchar *names[] = { first_name, second_name, NULL };
+
+  g_atomic_int_set (&filter_extended, TRUE);
+  epc_service_monitor_set_name_filter (data, names);
+
+  return NULL;
+}
+
+static void
+service_found_cb (EpcServiceMonitor *monitor,
+                  const gchar       *name,
+                  EpcServiceInfo    *info G_GNUC_UNUSED,
+                  gpointer           data G_GNUC_UNUSED)
+{
+  if (g_str_equal (name, first_name))
+    {
+      epc_test_pass_many (1 << 0);
+
+      if (!filter_thread)
+        filter_thread = g_thread_new ("filter", extend_filter_thread, monitor);
+    }
+
+  if (g_str_equal (name, second_name))
+    {
+      if (!g_atomic_int_get (&filter_extended))
+        g_error ("%s: `%s' resolved, but not matching the filter", G_STRLOC, name);
+
+      epc_test_pass_many (1 << 1);
+    }
+}
+
+int
+main (void)
+{
+  EpcDispatcher *first_dispatcher = NULL;
+  EpcDispatcher *second_dispatcher = NULL;
+  EpcServiceMonitor *monitor = NULL;
+  gint result = EPC_TEST_MASK_ALL;
+  GError *error = NULL;
+  gchar *names[] = { NULL, NULL };
+
+  test_type = g_strdup_printf ("_test-%08x._tcp", g_random_int ());
+  first_name = g_strdup_printf ("%s: %08x-1", __FILE__, g_random_int ());
+  second_name = g_strdup_printf ("%s: %08x-2", __FILE__, g_random_int ());
+
+  first_dispatcher = epc_dispatcher_new (first_name);
+  second_dispatcher = epc_dispatcher_new (second_name);
+
+  if (!epc_test_init (2) ||
+      !epc_dispatcher_run (first_dispatcher, &error) ||
+      !epc_dispatcher_run (second_dispatcher, &error))
+    goto out;
+
+  names[0] = first_name;
+  monitor = epc_service_monitor_new_for_types (NULL, test_type, NULL);
+  epc_service_monitor_set_name_filter (monitor, names);
+
+  g_signal_connect (monitor, "service-found",
+                    G_CALLBACK (service_found_cb), NULL);
+
+  epc_dispatcher_add_service (first_dispatcher, EPC_ADDRESS_UNSPEC,
+                              test_type, NULL, NULL, 2007, NULL);
+  epc_dispatcher_add_service (second_dispatcher, EPC_ADDRESS_UNSPEC,
+                              test_type, NULL, NULL, 2008, NULL);
+
+  result = epc_test_run ();
+
+out:
+  if (error)
+    g_print ("%s: %s\n", G_STRLOC, error->message);
+
+  g_clear_error (&error);
+
+  if (filter_thread)
+    g_thread_join (filter_thread);
+
+  if (monitor)
+    g_object_unref (monitor);
+  if (second_dispatcher)
+    g_object_unref (second_dispatcher);
+  if (first_dispatcher)
+    g_object_unref (first_dispatcher);
+
+  g_free (second_name);
+  g_free (first_name);
+  g_free (test_type);
+
+  return result;
+}
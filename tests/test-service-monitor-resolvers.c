@@ -0,0 +1,168 @@
+/* Easy Publish and Consume Library
+ * Copyright (C) 2007, 2008  Openismus GmbH
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Authors:
+ *      Mathias Hasselmann
+ */
+
+/* Test the resolver queue of the service monitor: the concurrency limit,
+ * suppression of duplicate resolves, and cancellation of vanished services.
+ */
+
+#include "framework.h"
+#include "libepc/dispatcher.h"
+#include "libepc/service-monitor.h"
+
+#define TEST_SERVICE_COUNT 3
+
+static gchar *test_type = NULL;
+static gchar *test_names[TEST_SERVICE_COUNT];
+static gchar *vanishing_name = NULL;
+
+static EpcDispatcher *vanishing_dispatcher = NULL;
+static GHashTable *resolved = NULL;
+static guint found_count = 0;
+
+static void
+service_found_cb (EpcServiceMonitor *monitor G_GNUC_UNUSED,
+                  const gchar       *name,
+                  EpcServiceInfo    *info,
+                  gpointer           data G_GNUC_UNUSED)
+{
+  gchar *key;
+  gint i;
+
+  /* Each announcement must be resolved just once. */
+  key = g_strdup_printf ("%s\n%s\n%d", name,
+                         epc_service_info_get_interface (info),
+                         epc_service_info_get_address_family (info));
+
+  if (g_hash_table_lookup (resolved, key))
+    g_error ("%s: `%s' resolved twice", G_STRLOC, name);
+
+  g_hash_table_insert (resolved, key, GINT_TO_POINTER (TRUE));
+
+  for (i = 0; i < TEST_SERVICE_COUNT; ++i)
+    if (g_str_equal (name, test_names[i]))
+      {
+        epc_test_pass_many (1 << i);
+        found_count += 1;
+      }
+
+  /* Withdraw the last service, while the others still wait in the queue. */
+  if (vanishing_dispatcher)
+    {
+      g_object_unref (vanishing_dispatcher);
+      vanishing_dispatcher = NULL;
+    }
+}
+
+static gboolean
+check_counts_cb (gpointer data)
+{
+  guint queued, active, completed;
+
+  epc_service_monitor_get_resolver_counts (data, &queued, &active, &completed);
+
+  if (active > 1)
+    g_error ("%s: %u resolvers running, but only one allowed", G_STRLOC, active);
+
+  /* Withdrawn services must not stay in the queue,
+   * and must not block a resolver slot. */
+  if (!vanishing_dispatcher && found_count >= TEST_SERVICE_COUNT &&
+      0 == queued && 0 == active)
+    epc_test_pass_once (1 << TEST_SERVICE_COUNT);
+
+  return TRUE;
+}
+
+int
+main (void)
+{
+  EpcDispatcher *dispatchers[TEST_SERVICE_COUNT] = { NULL, };
+  EpcServiceMonitor *monitor = NULL;
+  gint result = EPC_TEST_MASK_ALL;
+  GError *error = NULL;
+  guint check_id = 0;
+  gint i;
+
+  resolved = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  test_type = g_strdup_printf ("_test-%08x._tcp", g_random_int ());
+  vanishing_name = g_strdup_printf ("%s: %08x-v", __FILE__, g_random_int ());
+
+  for (i = 0; i < TEST_SERVICE_COUNT; ++i)
+    {
+      test_names[i] = g_strdup_printf ("%s: %08x-%d", __FILE__, g_random_int (), i);
+      dispatchers[i] = epc_dispatcher_new (test_names[i]);
+    }
+
+  vanishing_dispatcher = epc_dispatcher_new (vanishing_name);
+
+  if (!epc_test_init (TEST_SERVICE_COUNT + 1))
+    goto out;
+
+  for (i = 0; i < TEST_SERVICE_COUNT; ++i)
+    if (!epc_dispatcher_run (dispatchers[i], &error))
+      goto out;
+
+  if (!epc_dispatcher_run (vanishing_dispatcher, &error))
+    goto out;
+
+  monitor = epc_service_monitor_new_for_types (NULL, test_type, NULL);
+  epc_service_monitor_set_max_resolvers (monitor, 1);
+
+  g_signal_connect (monitor, "service-found",
+                    G_CALLBACK (service_found_cb), NULL);
+  check_id = g_timeout_add (1, check_counts_cb, monitor);
+
+  for (i = 0; i < TEST_SERVICE_COUNT; ++i)
+    epc_dispatcher_add_service (dispatchers[i], EPC_ADDRESS_UNSPEC,
+                                test_type, NULL, NULL, 2007 + i, NULL);
+
+  epc_dispatcher_add_service (vanishing_dispatcher, EPC_ADDRESS_UNSPEC,
+                              test_type, NULL, NULL, 2007 + i, NULL);
+
+  result = epc_test_run ();
+
+out:
+  if (error)
+    g_print ("%s: %s\n", G_STRLOC, error->message);
+
+  g_clear_error (&error);
+
+  if (check_id)
+    g_source_remove (check_id);
+
+  if (monitor)
+    g_object_unref (monitor);
+  if (vanishing_dispatcher)
+    g_object_unref (vanishing_dispatcher);
+
+  for (i = 0; i < TEST_SERVICE_COUNT; ++i)
+    {
+      if (dispatchers[i])
+        g_object_unref (dispatchers[i]);
+
+      g_free (test_names[i]);
+    }
+
+  g_hash_table_unref (resolved);
+  g_free (vanishing_name);
+  g_free (test_type);
+
+  return result;
+}